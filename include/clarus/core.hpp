@@ -26,6 +26,7 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #include <clarus/core/list.hpp>
 #include <clarus/core/math.hpp>
 #include <clarus/core/matrix.hpp>
+#include <clarus/core/parallel.hpp>
 #include <clarus/core/tuple.hpp>
 #include <clarus/core/types.hpp>
 
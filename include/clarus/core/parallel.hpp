@@ -0,0 +1,104 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_CORE_PARALLEL_HPP
+#define CLARUS_CORE_PARALLEL_HPP
+
+#include <boost/function.hpp>
+
+#include <opencv2/opencv.hpp>
+
+namespace clarus
+{
+
+namespace parallel
+{
+
+/**
+ * \brief Loop body type. Called with a range of task indices to process.
+ */
+typedef boost::function<void(const cv::Range&)> Body;
+
+/**
+ * \brief A horizontal band of matrix rows assigned to a parallel task.
+ */
+struct Band
+{
+  /** \brief Rows the task is responsible for writing. */
+  cv::Range rows;
+
+  /** \brief Rows the task may read: the band's rows extended by the halo, clipped to the matrix. */
+  cv::Range halo;
+};
+
+/**
+ * \brief Band body type. Called once for each band of rows to process.
+ */
+typedef boost::function<void(const Band&)> BandBody;
+
+/**
+ * \brief Set the maximum number of tasks run concurrently by parallel loops.
+ *
+ * Values lower than 1 remove the cap, leaving the decision to OpenCV's thread pool (this
+ * is the default). Setting the cap to 1 makes all parallel loops run on the calling thread.
+ */
+void setThreads(int n);
+
+/**
+ * \brief Return the maximum number of tasks run concurrently by parallel loops.
+ *
+ * A value lower than 1 means no cap is set.
+ */
+int threads();
+
+/**
+ * \brief Return the number of tasks parallel loops are expected to run concurrently.
+ *
+ * This is the cap set with setThreads() if any, otherwise the number of CPUs.
+ */
+int workers();
+
+/**
+ * \brief Run the given body over the task index range <tt>[0, n)</tt>.
+ *
+ * The range is split in contiguous chunks which are dispatched to OpenCV's thread pool
+ * through <tt>cv::parallel_for_()</tt>. If a cap was set with setThreads(), no more than
+ * that many chunks are created; otherwise a few chunks are created per CPU. The call
+ * returns after all tasks are complete.
+ */
+void run(int n, Body body);
+
+/**
+ * \brief Split the row range <tt>[0, rows)</tt> in horizontal bands and run the given body over them.
+ *
+ * Bands do not overlap, so bodies can write to their rows of a shared output matrix
+ * without synchronization. The \c halo argument is the number of rows above and below
+ * each band that the body needs to read (e.g. half a kernel's height); it is reflected in
+ * the <tt>Band::halo</tt> range, which bodies can use to extract their input sub-matrices.
+ *
+ * Several bands are created per worker thread, so uneven work is balanced across threads.
+ * Bands are at least a few rows tall, so small matrices may be processed by a single task.
+ */
+void bands(int rows, int halo, BandBody body);
+
+} // namespace parallel
+
+} // namespace clarus
+
+#endif
@@ -44,6 +44,9 @@ class clarus::Camera {
         /** \brief Wait between frame captures, in microseconds. */
         double fps;
 
+        /** \brief Size of raw frames, or an empty size if frames are converted to BGR. */
+        cv::Size rawSize;
+
         /** \brief Counter used to tell apart one frame from the next. */
         uint64_t generation;
 
@@ -96,6 +99,8 @@ class clarus::Camera {
 
         cv::Size size();
 
+        bool raw(bool enabled);
+
         double get(int id);
 
         void set(int id, double value);
@@ -140,6 +145,19 @@ public:
 
     cv::Size size();
 
+    /**
+    \brief Enables or disables raw capture mode.
+
+    In raw mode the capture backend is asked not to convert frames to BGR, so frames are
+    returned as delivered by the sensor, e.g. 8-bit Bayer mosaics that can be passed to
+    <tt>bayer::adaptive()</tt> or <tt>bayer::bilinear()</tt> directly. This saves a
+    full-frame color conversion per frame. Frames delivered as flat buffers are reshaped
+    to the camera's frame size.
+
+    Returns whether the backend accepted the change; not all backends support raw mode.
+    */
+    bool raw(bool enabled = true);
+
     double get(int id);
 
     void set(int id, double value);
@@ -20,13 +20,17 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_MODEL_HPP
 #define CLARUS_MODEL_HPP
 
+#include <clarus/model/assignment.hpp>
 #include <clarus/model/ballot.hpp>
 #include <clarus/model/cloud.hpp>
 #include <clarus/model/cluster.hpp>
 #include <clarus/model/dbscan.hpp>
+#include <clarus/model/kdtree.hpp>
 #include <clarus/model/line2d.hpp>
 #include <clarus/model/munkres.hpp>
 #include <clarus/model/point.hpp>
+#include <clarus/model/point_n.hpp>
+#include <clarus/model/point_set.hpp>
 #include <clarus/model/quadtree.hpp>
 #include <clarus/model/ransac.hpp>
 
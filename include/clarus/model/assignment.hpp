@@ -0,0 +1,198 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_MODEL_ASSIGNMENT_HPP
+#define CLARUS_MODEL_ASSIGNMENT_HPP
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+namespace clarus {
+    struct Assignment;
+
+    class Assigner;
+
+    class SparseCosts;
+
+    /*
+    Solves the linear assignment problem for the given cost matrix, finding the pairing
+    of rows and columns of minimum total cost. Each row is assigned to at most one column
+    and vice versa; min(rows, cols) pairs are made when possible.
+
+    The matrix can be of any shape, and of type CV_32F or CV_64F. Infinite (or NaN)
+    entries mark forbidden pairs: the solution then has as many allowed pairs as
+    possible, of minimum total cost, and rows or columns left over are unassigned.
+
+    The solver follows the shortest augmenting path method of Jonker and Volgenant
+    ("A shortest augmenting path algorithm for dense and sparse linear assignment
+    problems", Computing 38, 1987): each row is added by a Dijkstra-like search over
+    reduced costs, maintaining dual variables, for O(n^2 m) time and O(n + m) memory
+    on an n x m matrix (n <= m).
+    */
+    Assignment assign(const cv::Mat &costs);
+}
+
+/*
+Solution of a linear assignment problem.
+*/
+struct clarus::Assignment {
+    /* Column assigned to each row, or -1 for unassigned rows. */
+    std::vector<int> rows;
+
+    /* Row assigned to each column, or -1 for unassigned columns. */
+    std::vector<int> cols;
+
+    /* Total cost of the assigned pairs. */
+    double cost;
+
+    Assignment();
+
+    /*
+    Returns the number of assigned pairs.
+    */
+    int size() const;
+};
+
+/*
+Sparse cost structure for assignment problems where most pairs are forbidden, such as
+gated frame-to-frame tracking: each row holds a list of candidate columns and their costs,
+and pairs not listed are forbidden.
+*/
+class clarus::SparseCosts {
+public:
+    /*
+    Candidate column for a row, and the cost of pairing them.
+    */
+    struct Candidate {
+        /* Column index. */
+        int col;
+
+        /* Pairing cost. */
+        double cost;
+
+        Candidate(int col, double cost);
+    };
+
+private:
+    /* Number of columns. */
+    int m;
+
+    /* Candidate lists, one per row. */
+    std::vector<std::vector<Candidate> > candidates;
+
+public:
+    /*
+    Creates a new cost structure of given dimensions, with all pairs forbidden.
+    */
+    SparseCosts(int rows = 0, int cols = 0);
+
+    /*
+    Returns the candidate list of the given row.
+    */
+    const std::vector<Candidate> &operator [] (int row) const;
+
+    /*
+    Adds a candidate pair. Infinite or NaN costs are ignored.
+    */
+    void add(int row, int col, double cost);
+
+    /*
+    Forbids all pairs, keeping the matrix dimensions.
+    */
+    void clear();
+
+    /*
+    Resizes the structure to the given dimensions, forbidding all pairs.
+    */
+    void resize(int rows, int cols);
+
+    /*
+    Returns the number of rows.
+    */
+    int rows() const;
+
+    /*
+    Returns the number of columns.
+    */
+    int cols() const;
+};
+
+/*
+Incremental assignment solver over sparse costs, meant to be called once per frame of a
+tracking sequence. Results follow the same rules as clarus::assign(): as many allowed pairs
+as possible are made, at minimum total cost.
+
+Rows are paired by the same shortest augmenting path method as clarus::assign(), with the
+Dijkstra search run over a heap and the candidate lists only, so each augmentation costs
+O(k log k) for k candidate pairs reached. Between calls the solver keeps its column dual
+variables and the previous assignment; on the next call, previous pairs that are still
+candidates and optimal under the kept duals are restored outright, and only the remaining
+rows are augmented. When costs change little from frame to frame, most rows carry over
+and a call takes time close to linear in the number of candidates.
+
+Warm starts assume row and column indices keep their meaning across calls (e.g. rows are
+tracks and columns are gates indexed by track). If the indexing changes, call reset()
+first. Warm starts affect running time only, never the total cost of the result.
+*/
+class clarus::Assigner {
+    /* Dual variables of the columns at the end of the last call. */
+    std::vector<double> prices;
+
+    /* Dual variables of each row's "unassigned" option at the end of the last call. */
+    std::vector<double> reserves;
+
+    /* Column assigned to each row in the last call, or -1. */
+    std::vector<int> previous;
+
+    /* Number of rows carried over in the last call. */
+    int kept;
+
+    /* Number of augmentations performed in the last call. */
+    int augmented;
+
+public:
+    /*
+    Creates a new solver with no previous state.
+    */
+    Assigner();
+
+    /*
+    Solves the assignment problem for the given costs, warm-started from the previous call.
+    */
+    Assignment operator () (const SparseCosts &costs);
+
+    /*
+    Returns the number of augmenting paths searched in the last call. Rows not carried
+    over from the previous call need one each.
+    */
+    int augmentations() const;
+
+    /*
+    Returns the number of rows whose previous assignment was carried over in the last call.
+    */
+    int carried() const;
+
+    /*
+    Discards the previous state, so the next call solves from scratch.
+    */
+    void reset();
+};
+
+#endif
@@ -21,6 +21,7 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #define CLARUS_MODEL_BALLOT_HPP
 
 #include <clarus/model/ballot_discrete.hpp>
+#include <clarus/model/ballot_table.hpp>
 #include <clarus/model/ballot_weighted.hpp>
 
 #endif
@@ -20,51 +20,119 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_MODEL_BALLOT_DISCRETE_HPP
 #define CLARUS_MODEL_BALLOT_DISCRETE_HPP
 
-#include <map>
+#include <clarus/model/ballot_table.hpp>
 
 namespace ballot {
-    template<class X> class discrete;
+    template<class X, template<class, class> class Table = ordered> class discrete;
 }
 
-template<class X> class ballot::discrete {
-    typedef std::map<X, int> Votes;
+/*
+Ballot counting one vote per call to vote(). The winner is the candidate with the most
+votes, ties going to the least candidate; it is kept up to date as votes are cast, so
+winner() and count() take constant time.
+
+Votes are kept in a table of the given type (see ballot_table.hpp), e.g. use
+ballot::discrete<int, ballot::dense> for small non-negative integer labels. To vote in
+parallel, give each task its own ballot and merge() them afterwards.
+*/
+template<class X, template<class, class> class Table> class ballot::discrete {
+    typedef Table<X, int> Votes;
+
+    /*
+    Adds the votes of another ballot, one candidate at a time.
+    */
+    struct Merger {
+        discrete &ballot;
+
+        Merger(discrete &ballot);
+
+        void operator () (const X &x, int votes);
+    };
+
+    friend struct Merger;
 
     Votes votes;
 
+    /* Current winner, valid if lead > 0. */
+    X leader;
+
+    /* Number of votes of the current winner. */
+    int lead;
+
+    void update(const X &x, int count);
+
 public:
+    discrete();
+
     void vote(const X &x);
 
+    /*
+    Adds the votes cast on another ballot to this one.
+    */
+    void merge(const discrete &that);
+
+    /*
+    Discards all votes.
+    */
+    void clear();
+
     const X &winner() const;
 
     int count() const;
 };
 
-template<class X> void ballot::discrete<X>::vote(const X &x) {
-    if (votes.count(x) == 0) {
-        votes[x] = 1;
-    }
-    else {
-        votes[x] += 1;
+template<class X, template<class, class> class Table> ballot::discrete<X, Table>::Merger::Merger(discrete &_ballot):
+    ballot(_ballot)
+{
+    // Nothing to do.
+}
+
+template<class X, template<class, class> class Table> void ballot::discrete<X, Table>::Merger::operator () (const X &x, int votes) {
+    if (votes > 0) {
+        int &count = ballot.votes[x];
+        count += votes;
+        ballot.update(x, count);
     }
 }
 
-template<class X> const X &ballot::discrete<X>::winner() const {
-    typename Votes::const_iterator w = votes.begin();
-    int count = 0;
+template<class X, template<class, class> class Table> ballot::discrete<X, Table>::discrete():
+    votes(),
+    leader(),
+    lead(0)
+{
+    // Nothing to do.
+}
 
-    for (typename Votes::const_iterator i = votes.begin(), n = votes.end(); i != n; ++i) {
-        int voting = i->second;
-        if (voting > count) {
-            count = voting;
-            w = i;
-        }
+template<class X, template<class, class> class Table> void ballot::discrete<X, Table>::update(const X &x, int count) {
+    if (count > lead || (count == lead && x < leader)) {
+        lead = count;
+        leader = x;
     }
+}
+
+template<class X, template<class, class> class Table> void ballot::discrete<X, Table>::vote(const X &x) {
+    int &count = votes[x];
+    count += 1;
+    update(x, count);
+}
+
+template<class X, template<class, class> class Table> void ballot::discrete<X, Table>::merge(const discrete &that) {
+    Merger merger(*this);
+    that.votes.visit(merger);
+}
+
+template<class X, template<class, class> class Table> void ballot::discrete<X, Table>::clear() {
+    votes.clear();
+    leader = X();
+    lead = 0;
+}
 
-    return w->first;
+template<class X, template<class, class> class Table> const X &ballot::discrete<X, Table>::winner() const {
+    return leader;
 }
 
-template<class X> int ballot::discrete<X>::count() const {
-    return votes.find(winner())->second;
+template<class X, template<class, class> class Table> int ballot::discrete<X, Table>::count() const {
+    return lead;
 }
 
 #endif
@@ -0,0 +1,235 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_MODEL_BALLOT_TABLE_HPP
+#define CLARUS_MODEL_BALLOT_TABLE_HPP
+
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+/*
+Vote tables used by ballots. A table maps candidates of type X to tallies of type V,
+with the interface:
+
+    V &operator [] (const X &x); // Returns the tally of x, inserting V() if needed.
+    template<class F> void visit(F &f) const; // Calls f(x, tally) for every entry.
+    void clear();
+
+Ballots take the table as a template argument, so the storage can be picked to suit the
+candidates: ordered (the default) works for any ordered type, dense for small integral
+labels, and hashed for sparse hashable keys.
+*/
+namespace ballot {
+    template<class X, class V> class ordered;
+
+    template<class X, class V> class dense;
+
+    template<class X, class V> class hashed;
+}
+
+/*
+Vote table over a std::map.
+*/
+template<class X, class V> class ballot::ordered {
+    typedef std::map<X, V> Tallies;
+
+    Tallies tallies;
+
+public:
+    V &operator [] (const X &x);
+
+    template<class F> void visit(F &f) const;
+
+    void clear();
+};
+
+/*
+Vote table over a flat array indexed by candidate, for integral labels in a small range
+[0, n). The array grows as needed to hold the largest label seen; visit() reports every
+label up to that one, including those with empty tallies.
+*/
+template<class X, class V> class ballot::dense {
+    std::vector<V> tallies;
+
+public:
+    V &operator [] (const X &x);
+
+    template<class F> void visit(F &f) const;
+
+    void clear();
+};
+
+/*
+Vote table over a single open-addressing hash table with linear probing, for sparse
+keys. Keys are hashed with boost::hash, and the table is kept at most half full.
+*/
+template<class X, class V> class ballot::hashed {
+    std::vector<X> keys;
+
+    std::vector<V> tallies;
+
+    std::vector<char> used;
+
+    /* Number of entries in the table. */
+    size_t entries;
+
+    /* Base-2 logarithm of the table's capacity. */
+    int bits;
+
+    size_t find(const X &x) const;
+
+    void grow();
+
+public:
+    hashed();
+
+    V &operator [] (const X &x);
+
+    template<class F> void visit(F &f) const;
+
+    void clear();
+};
+
+template<class X, class V> V &ballot::ordered<X, V>::operator [] (const X &x) {
+    return tallies[x];
+}
+
+template<class X, class V> template<class F> void ballot::ordered<X, V>::visit(F &f) const {
+    for (typename Tallies::const_iterator i = tallies.begin(), n = tallies.end(); i != n; ++i) {
+        f(i->first, i->second);
+    }
+}
+
+template<class X, class V> void ballot::ordered<X, V>::clear() {
+    tallies.clear();
+}
+
+template<class X, class V> V &ballot::dense<X, V>::operator [] (const X &x) {
+    if (x < 0) {
+        throw std::runtime_error("Dense ballot labels must be non-negative");
+    }
+
+    size_t index = x;
+    if (index >= tallies.size()) {
+        tallies.resize(index + 1);
+    }
+
+    return tallies[index];
+}
+
+template<class X, class V> template<class F> void ballot::dense<X, V>::visit(F &f) const {
+    for (size_t i = 0, n = tallies.size(); i < n; i++) {
+        f(X(i), tallies[i]);
+    }
+}
+
+template<class X, class V> void ballot::dense<X, V>::clear() {
+    tallies.clear();
+}
+
+template<class X, class V> ballot::hashed<X, V>::hashed():
+    keys(),
+    tallies(),
+    used(),
+    entries(0),
+    bits(0)
+{
+    // Nothing to do.
+}
+
+template<class X, class V> size_t ballot::hashed<X, V>::find(const X &x) const {
+    // Fibonacci hashing spreads consecutive keys (e.g. small integer labels) over the table.
+    boost::uint64_t h = boost::hash<X>()(x);
+    size_t mask = keys.size() - 1;
+    size_t i = (h * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+    while (used[i] && !(keys[i] == x)) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+template<class X, class V> void ballot::hashed<X, V>::grow() {
+    std::vector<X> old_keys;
+    std::vector<V> old_tallies;
+    std::vector<char> old_used;
+    old_keys.swap(keys);
+    old_tallies.swap(tallies);
+    old_used.swap(used);
+
+    bits = (bits == 0 ? 4 : bits + 1);
+    size_t capacity = size_t(1) << bits;
+    keys.resize(capacity);
+    tallies.resize(capacity);
+    used.resize(capacity, false);
+
+    for (size_t i = 0, n = old_keys.size(); i < n; i++) {
+        if (old_used[i]) {
+            size_t j = find(old_keys[i]);
+            keys[j] = old_keys[i];
+            tallies[j] = old_tallies[i];
+            used[j] = true;
+        }
+    }
+}
+
+template<class X, class V> V &ballot::hashed<X, V>::operator [] (const X &x) {
+    if (bits == 0) {
+        grow();
+    }
+
+    size_t i = find(x);
+    if (used[i]) {
+        return tallies[i];
+    }
+
+    if (2 * (entries + 1) > keys.size()) {
+        grow();
+        i = find(x);
+    }
+
+    keys[i] = x;
+    tallies[i] = V();
+    used[i] = true;
+    entries++;
+
+    return tallies[i];
+}
+
+template<class X, class V> template<class F> void ballot::hashed<X, V>::visit(F &f) const {
+    for (size_t i = 0, n = keys.size(); i < n; i++) {
+        if (used[i]) {
+            f(keys[i], tallies[i]);
+        }
+    }
+}
+
+template<class X, class V> void ballot::hashed<X, V>::clear() {
+    keys.clear();
+    tallies.clear();
+    used.clear();
+    entries = 0;
+    bits = 0;
+}
+
+#endif
@@ -20,30 +20,85 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_MODEL_BALLOT_WEIGHTED_HPP
 #define CLARUS_MODEL_BALLOT_WEIGHTED_HPP
 
-#include <map>
+#include <clarus/model/ballot_table.hpp>
 
 namespace ballot {
-    template<class X> class weighted;
+    struct tally;
+
+    template<class X, template<class, class> class Table = ordered> class weighted;
 }
 
-template<class X> class ballot::weighted {
-    std::map<X, int> counts;
+/*
+Running tally of a candidate in a weighted ballot.
+*/
+struct ballot::tally {
+    /* Number of votes. */
+    int count;
+
+    /* Sum of vote weights. */
+    double value;
+
+    /* Mean error of the votes. */
+    double error;
 
-    std::map<X, double> values;
+    tally();
 
-    std::map<X, double> errors;
+    /*
+    Adds the votes of another tally to this one.
+    */
+    tally &operator += (const tally &that);
+};
+
+/*
+Ballot where each vote comes with an error e, and is weighted by 1 / (1 + e). The winner
+is the first candidate to reach the largest sum of weights.
+
+Tallies are kept in a table of the given type (see ballot_table.hpp), so each vote costs
+a single lookup; e.g. use ballot::weighted<int, ballot::dense> for small non-negative
+integer labels. To vote in parallel, give each task its own ballot and merge() them
+afterwards.
+*/
+template<class X, template<class, class> class Table> class ballot::weighted {
+    typedef Table<X, tally> Tallies;
+
+    /*
+    Adds the tallies of another ballot, one candidate at a time.
+    */
+    struct Merger {
+        weighted &ballot;
+
+        Merger(weighted &ballot);
+
+        void operator () (const X &x, const tally &votes);
+    };
+
+    friend struct Merger;
+
+    Tallies tallies;
 
     double lead;
 
-    const X *best;
+    X best;
 
     double least;
 
+    void update(const X &x, const tally &votes);
+
 public:
     weighted();
 
     void add(const X &x, double e);
 
+    /*
+    Adds the votes cast on another ballot to this one.
+    */
+    void merge(const weighted &that);
+
+    /*
+    Discards all votes.
+    */
+    void clear();
+
     const X &winner() const;
 
     double error() const;
@@ -51,43 +106,85 @@ public:
     double likelihood() const;
 };
 
-template<class X> ballot::weighted<X>::weighted():
-    counts(),
-    values(),
-    errors(),
+inline ballot::tally::tally():
+    count(0),
+    value(0.0),
+    error(0.0)
+{
+    // Nothing to do.
+}
+
+inline ballot::tally &ballot::tally::operator += (const tally &that) {
+    if (that.count > 0) {
+        int total = count + that.count;
+        error = (error * count + that.error * that.count) / total;
+        value += that.value;
+        count = total;
+    }
+
+    return *this;
+}
+
+template<class X, template<class, class> class Table> ballot::weighted<X, Table>::Merger::Merger(weighted &_ballot):
+    ballot(_ballot)
+{
+    // Nothing to do.
+}
+
+template<class X, template<class, class> class Table> void ballot::weighted<X, Table>::Merger::operator () (const X &x, const tally &votes) {
+    if (votes.count > 0) {
+        tally &merged = ballot.tallies[x];
+        merged += votes;
+        ballot.update(x, merged);
+    }
+}
+
+template<class X, template<class, class> class Table> ballot::weighted<X, Table>::weighted():
+    tallies(),
     lead(0.0),
-    best(NULL),
+    best(),
     least(0.0)
 {
     // Nothing to do.
 }
 
-template<class X> void ballot::weighted<X>::add(const X &x, double e) {
-    int &count = counts[x];
-    count += 1;
+template<class X, template<class, class> class Table> void ballot::weighted<X, Table>::update(const X &x, const tally &votes) {
+    if (votes.value > lead) {
+        lead = votes.value;
+        best = x;
+        least = votes.error;
+    }
+}
 
-    double &value = values[x];
-    value += 1.0 / (1 + e);
+template<class X, template<class, class> class Table> void ballot::weighted<X, Table>::add(const X &x, double e) {
+    tally &votes = tallies[x];
+    votes.count += 1;
+    votes.value += 1.0 / (1 + e);
+    votes.error += (1.0 / votes.count) * (e - votes.error);
+    update(x, votes);
+}
 
-    double &error = errors[x];
-    error += (1.0 / count) * (e - error);
+template<class X, template<class, class> class Table> void ballot::weighted<X, Table>::merge(const weighted &that) {
+    Merger merger(*this);
+    that.tallies.visit(merger);
+}
 
-    if (value > lead) {
-        lead = value;
-        best = &(values.find(x)->first);
-        least = error;
-    }
+template<class X, template<class, class> class Table> void ballot::weighted<X, Table>::clear() {
+    tallies.clear();
+    lead = 0.0;
+    best = X();
+    least = 0.0;
 }
 
-template<class X> const X &ballot::weighted<X>::winner() const {
-    return *best;
+template<class X, template<class, class> class Table> const X &ballot::weighted<X, Table>::winner() const {
+    return best;
 }
 
-template<class X> double ballot::weighted<X>::error() const {
+template<class X, template<class, class> class Table> double ballot::weighted<X, Table>::error() const {
     return least;
 }
 
-template<class X> double ballot::weighted<X>::likelihood() const {
+template<class X, template<class, class> class Table> double ballot::weighted<X, Table>::likelihood() const {
     return lead;
 }
 
@@ -23,8 +23,66 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #include <clarus/core/list.hpp>
 #include <clarus/model/cloud.hpp>
 
+#include <vector>
+
 namespace dbscan {
-    clarus::Cloud run(const clarus::List<clarus::Point> &points, float e, size_t b);
+    /*
+    Label of points not assigned to any cluster.
+    */
+    const int NOISE = -1;
+
+    /*
+    Memory used by a clustering run, in bytes.
+    */
+    struct Usage {
+        /* Spatial index over the input points. */
+        size_t index;
+
+        /* Per-point arrays: labels, core point flags and the queued bitset. */
+        size_t labels;
+
+        /* Peak size of the expansion frontier and neighborhood buffers. */
+        size_t frontier;
+
+        Usage();
+
+        size_t total() const;
+    };
+
+    /*
+    Compact result of a clustering run.
+    */
+    struct Labels {
+        /* Index of the cluster each point was assigned to, or NOISE. */
+        std::vector<int> labels;
+
+        /* Number of clusters found. */
+        int clusters;
+
+        /* Memory used by the run, including the labels returned here. */
+        Usage usage;
+
+        Labels();
+    };
+
+    /*
+    Clusters the given points with DBSCAN, using neighborhood radius e and minimum
+    neighborhood size b (including the point itself), and returns the cluster index of
+    each point.
+
+    Clusters are numbered in the order they are found. Memory use is linear in the
+    number of points: each point enters the expansion frontier at most once, tracked by
+    a bitset, and clusters are recorded as labels rather than point copies.
+    */
+    Labels label(const clarus::List<clarus::Point> &points, float e, size_t b);
+
+    /*
+    Clusters the given points with DBSCAN, as label(), and returns the clusters as
+    lists of points, each in the order its points were reached by the expansion.
+
+    If usage is not NULL, it receives the memory used by the run.
+    */
+    clarus::Cloud run(const clarus::List<clarus::Point> &points, float e, size_t b, Usage *usage = NULL);
 };
 
 #endif
@@ -0,0 +1,147 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_MODEL_KDTREE_HPP
+#define CLARUS_MODEL_KDTREE_HPP
+
+#include <clarus/core/list.hpp>
+#include <clarus/model/point.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace clarus {
+    class KDTree;
+}
+
+/*
+Static k-d tree over a list of points, answering radius and nearest-neighbor queries in
+spaces of any dimension. Build it once over a point set, then query it many times.
+
+Point coordinates are copied into a flat array when the tree is built, so later changes
+to the point list are not reflected in the tree. Points of lower dimension than others are
+padded with zeros, consistently with distance2(). Queries return indices into the original
+point list.
+*/
+class clarus::KDTree {
+    /* Tree node, covering a contiguous range of the order array. */
+    struct Node {
+        /* Range of the order array covered by this node. */
+        int begin, end;
+
+        /* Splitting axis, or -1 for leaf nodes. */
+        int axis;
+
+        /* Splitting value: left points are not greater, right points not smaller. */
+        double split;
+
+        /* Indices of the child nodes in the nodes array. */
+        int left, right;
+    };
+
+    /* Dimension of the indexed space. */
+    size_t d;
+
+    /* Point coordinates, d per point, in the order of the original point list. */
+    std::vector<double> coords;
+
+    /* Point indices, arranged so each node's points are contiguous. */
+    std::vector<int> order;
+
+    /* Tree nodes; the root is the first one. */
+    std::vector<Node> nodes;
+
+    /* Recursively builds the subtree over the given range of the order array. */
+    int build(int begin, int end, size_t leaf);
+
+    /*
+    Copies the coordinates of p into x, padded or truncated to the tree's dimension, and
+    returns the squared norm of the truncated coordinates.
+    */
+    double project(const Point &p, std::vector<double> &x) const;
+
+public:
+    /*
+    Creates a new empty tree.
+    */
+    KDTree();
+
+    /*
+    Builds a tree over the given points. Leaves hold up to the given number of points.
+    */
+    KDTree(const List<Point> &points, size_t leaf = 8);
+
+    /*
+    Returns the indices of the points within distance r (inclusive) of the given point.
+    */
+    List<int> radius(const Point &p, double r) const;
+
+    /*
+    Fills keys with the indices of the points within squared distance r2 (inclusive) of
+    the point of coordinates x, which must be an array of dimension() values. The indices
+    are not returned in any particular order.
+    */
+    void radius2(const double *x, double r2, std::vector<int> &keys) const;
+
+    /*
+    Returns the index of the point nearest to p, or -1 if the tree is empty. If distance
+    is not NULL, it receives the distance to that point.
+
+    If epsilon is greater than zero the search is approximate: the returned point may be
+    up to (1 + epsilon) times farther than the true nearest point, in exchange for
+    visiting fewer nodes.
+    */
+    int closest(const Point &p, double *distance = NULL, double epsilon = 0) const;
+
+    /*
+    Returns the indices of the k points nearest to p, sorted by increasing distance. If
+    epsilon is greater than zero, the i-th returned point may be up to (1 + epsilon)
+    times farther than the true i-th nearest point.
+    */
+    List<int> nearest(const Point &p, int k, double epsilon = 0) const;
+
+    /*
+    Fills best with the (squared distance, index) pairs of the k points nearest to the
+    point of coordinates x (an array of dimension() values), sorted by increasing
+    distance. See nearest() for the meaning of epsilon.
+    */
+    void nearest2(const double *x, int k, double epsilon, std::vector<std::pair<double, int> > &best) const;
+
+    /*
+    Returns the coordinates of the point of given index, as an array of dimension() values.
+    */
+    const double *coordinates(int index) const;
+
+    /*
+    Returns the dimension of the indexed space.
+    */
+    size_t dimension() const;
+
+    /*
+    Returns the memory used by the tree, in bytes.
+    */
+    size_t memory() const;
+
+    /*
+    Returns the number of indexed points.
+    */
+    size_t size() const;
+};
+
+#endif
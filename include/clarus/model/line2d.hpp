@@ -22,6 +22,9 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/core/list.hpp>
 #include <clarus/model/point.hpp>
+#include <clarus/model/point_set.hpp>
+
+#include <cstddef>
 
 namespace clarus {
     class Line2D;
@@ -38,6 +41,8 @@ class clarus::Line2D {
     double t;
 
 public:
+    class Points;
+
     Line2D();
 
     /*
@@ -61,6 +66,19 @@ public:
     */
     void fit(const Point &p0, const Point &p1, double dx = 1.0);
 
+    /*
+    Writes the distance between this line and each of the n points given by the xs and ys
+    coordinate arrays to the output array. The loop runs over contiguous arrays without
+    branches, so compilers can turn it into SIMD code.
+    */
+    void distances(const double *xs, const double *ys, size_t n, double *out) const;
+
+    /*
+    Writes the distance between this line and each point in the range [begin, end) of the
+    given set to the output array.
+    */
+    void distances(const Points &points, size_t begin, size_t end, double *out) const;
+
     double angle() const;
 
     double intercept() const;
@@ -68,6 +86,27 @@ public:
     double slope() const;
 };
 
+/*
+Set of points laid out as a structure of arrays, for computing distances to lines in
+batches. Like distance(Line2D, Point), it rejects points of dimension < 2.
+
+RANSAC models derived from Line2D can opt into batched scoring by declaring it as their
+Batch type (see ransac_batch):
+
+    typedef clarus::Line2D::Points Batch;
+
+Do so only if the model's distance(const Point&) is the line distance, since batched
+scoring calls Line2D::distances() instead.
+*/
+class clarus::Line2D::Points: public PointSet<2> {
+public:
+    /*
+    Creates a new point set from the given list. Throws std::runtime_error if any point
+    has dimension < 2.
+    */
+    explicit Points(const List<Point> &points);
+};
+
 namespace clarus {
     double distance(const Line2D &line, const Point &point);
 
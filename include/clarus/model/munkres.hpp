@@ -25,19 +25,14 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <opencv2/opencv.hpp>
 
-#include <utility>
-
 namespace clarus {
     /*
-    Implements the Hungarian algorithm [1]. Code adapted from [2].
-
-    The input matrix is expected to be of type CV_64F and w <= h for data.size() == cv::Size(w, h).
-
-    Assignments are returned in the form (row index, column index). To invert the order
-    of the terms, set the optional rowfirst attribute to false.
+    Solves the assignment problem for the given cost matrix, returning the minimum-cost
+    pairing of rows and columns. See clarus::assign() for details; the matrix may be of
+    any shape, of type CV_32F or CV_64F, with infinite entries marking forbidden pairs.
 
-    [1] http://en.wikipedia.org/wiki/Hungarian_algorithm
-    [2] https://github.com/saebyn/munkres-cpp
+    Assignments are returned in the form (row index, column index), ordered by row. To
+    invert the order of the terms, set the optional rowfirst attribute to false.
     */
     List<Point> munkres(const cv::Mat &data, bool rowfirst = true);
 }
@@ -0,0 +1,253 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_MODEL_POINT_N_HPP
+#define CLARUS_MODEL_POINT_N_HPP
+
+#include <clarus/model/point.hpp>
+
+#include <boost/static_assert.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+namespace clarus {
+    template<int N> class PointN;
+
+    typedef PointN<2> Point2;
+
+    typedef PointN<3> Point3;
+
+    /*
+    Computes the squared distance between two points.
+    */
+    template<int N> double distance2(const PointN<N> &p0, const PointN<N> &p1);
+
+    /*
+    Computes the distance between two points.
+    */
+    template<int N> double distance(const PointN<N> &p0, const PointN<N> &p1);
+}
+
+/*
+A point in N-dimensional cartesian space, with the dimension fixed at compile time.
+
+Unlike Point, objects of this class are plain values: coordinates are stored inline, so
+creating, copying and operating on points involves no heap allocation and no indirect
+calls. The explicit conversions from and to Point allow code to be migrated gradually.
+*/
+template<int N> class clarus::PointN {
+    BOOST_STATIC_ASSERT(N > 0);
+
+    /* Point coordinates. */
+    double values[N];
+
+public:
+    /*
+    Creates a new point at the origin.
+    */
+    PointN();
+
+    /*
+    Creates a new 2D point. Only available for N = 2.
+    */
+    PointN(double x0, double x1);
+
+    /*
+    Creates a new 3D point. Only available for N = 3.
+    */
+    PointN(double x0, double x1, double x2);
+
+    /*
+    Creates a new point from an array of N coordinates.
+    */
+    explicit PointN(const double *values);
+
+    /*
+    Creates a new point from a dynamic point. Missing coordinates are set to zero, and
+    coordinates beyond the N-th are dropped.
+    */
+    explicit PointN(const Point &point);
+
+    /*
+    Converts this point to a dynamic point.
+    */
+    Point point() const;
+
+    double &operator [] (int index);
+
+    const double &operator [] (int index) const;
+
+    bool operator == (const PointN &that) const;
+
+    bool operator != (const PointN &that) const;
+
+    PointN &operator += (const PointN &that);
+
+    PointN &operator -= (const PointN &that);
+
+    PointN &operator *= (double v);
+
+    PointN &operator /= (double v);
+
+    PointN operator + (const PointN &that) const;
+
+    PointN operator - (const PointN &that) const;
+
+    PointN operator * (double v) const;
+
+    PointN operator / (double v) const;
+
+    size_t dimension() const;
+};
+
+template<int N> clarus::PointN<N>::PointN() {
+    for (int i = 0; i < N; i++) {
+        values[i] = 0.0;
+    }
+}
+
+template<int N> clarus::PointN<N>::PointN(double x0, double x1) {
+    BOOST_STATIC_ASSERT(N == 2);
+    values[0] = x0;
+    values[1] = x1;
+}
+
+template<int N> clarus::PointN<N>::PointN(double x0, double x1, double x2) {
+    BOOST_STATIC_ASSERT(N == 3);
+    values[0] = x0;
+    values[1] = x1;
+    values[2] = x2;
+}
+
+template<int N> clarus::PointN<N>::PointN(const double *_values) {
+    for (int i = 0; i < N; i++) {
+        values[i] = _values[i];
+    }
+}
+
+template<int N> clarus::PointN<N>::PointN(const Point &point) {
+    int n = point.dimension();
+    for (int i = 0; i < N; i++) {
+        values[i] = (i < n ? point[i] : 0.0);
+    }
+}
+
+template<int N> clarus::Point clarus::PointN<N>::point() const {
+    List<double> coordinates(N);
+    for (int i = 0; i < N; i++) {
+        coordinates[i] = values[i];
+    }
+
+    return Point(coordinates);
+}
+
+template<int N> double &clarus::PointN<N>::operator [] (int index) {
+    return values[index];
+}
+
+template<int N> const double &clarus::PointN<N>::operator [] (int index) const {
+    return values[index];
+}
+
+template<int N> bool clarus::PointN<N>::operator == (const PointN &that) const {
+    for (int i = 0; i < N; i++) {
+        if (values[i] != that.values[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<int N> bool clarus::PointN<N>::operator != (const PointN &that) const {
+    return !(*this == that);
+}
+
+template<int N> clarus::PointN<N> &clarus::PointN<N>::operator += (const PointN &that) {
+    for (int i = 0; i < N; i++) {
+        values[i] += that.values[i];
+    }
+
+    return *this;
+}
+
+template<int N> clarus::PointN<N> &clarus::PointN<N>::operator -= (const PointN &that) {
+    for (int i = 0; i < N; i++) {
+        values[i] -= that.values[i];
+    }
+
+    return *this;
+}
+
+template<int N> clarus::PointN<N> &clarus::PointN<N>::operator *= (double v) {
+    for (int i = 0; i < N; i++) {
+        values[i] *= v;
+    }
+
+    return *this;
+}
+
+template<int N> clarus::PointN<N> &clarus::PointN<N>::operator /= (double v) {
+    for (int i = 0; i < N; i++) {
+        values[i] /= v;
+    }
+
+    return *this;
+}
+
+template<int N> clarus::PointN<N> clarus::PointN<N>::operator + (const PointN &that) const {
+    PointN result(*this);
+    return result += that;
+}
+
+template<int N> clarus::PointN<N> clarus::PointN<N>::operator - (const PointN &that) const {
+    PointN result(*this);
+    return result -= that;
+}
+
+template<int N> clarus::PointN<N> clarus::PointN<N>::operator * (double v) const {
+    PointN result(*this);
+    return result *= v;
+}
+
+template<int N> clarus::PointN<N> clarus::PointN<N>::operator / (double v) const {
+    PointN result(*this);
+    return result /= v;
+}
+
+template<int N> size_t clarus::PointN<N>::dimension() const {
+    return N;
+}
+
+template<int N> double clarus::distance2(const PointN<N> &p0, const PointN<N> &p1) {
+    double d = 0.0;
+    for (int i = 0; i < N; i++) {
+        double delta = p0[i] - p1[i];
+        d += delta * delta;
+    }
+
+    return d;
+}
+
+template<int N> double clarus::distance(const PointN<N> &p0, const PointN<N> &p1) {
+    return std::sqrt(distance2(p0, p1));
+}
+
+#endif
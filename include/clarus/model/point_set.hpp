@@ -0,0 +1,294 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_MODEL_POINT_SET_HPP
+#define CLARUS_MODEL_POINT_SET_HPP
+
+#include <clarus/model/cluster.hpp>
+#include <clarus/model/point_n.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace clarus {
+    template<int N> class PointSet;
+}
+
+/*
+Set of N-dimensional points stored as a structure of arrays: one contiguous array per
+axis. Kernels over the whole set (distances, bounds, means) then run as simple loops
+over contiguous doubles, which compilers turn into SIMD code, and never touch the heap.
+
+Point sets can be built from lists of dynamic points (e.g. a Cluster) and converted
+back, so they can be introduced one algorithm at a time.
+*/
+template<int N> class clarus::PointSet {
+    /* Coordinates of all points, one array per axis. */
+    std::vector<double> axes[N];
+
+public:
+    /*
+    Creates a new empty point set.
+    */
+    PointSet();
+
+    /*
+    Creates a new point set from a list of dynamic points, converted as by PointN(Point).
+    */
+    explicit PointSet(const List<Point> &points);
+
+    /*
+    Returns the point of given index.
+    */
+    PointN<N> operator [] (int index) const;
+
+    /*
+    Appends a point to the set.
+    */
+    void append(const PointN<N> &point);
+
+    /*
+    Replaces the point of given index.
+    */
+    void set(int index, const PointN<N> &point);
+
+    /*
+    Returns the array of coordinates of all points along axis k.
+    */
+    double *axis(int k);
+
+    const double *axis(int k) const;
+
+    /*
+    Writes the squared distance between the given point and each point in the set to
+    the output array, which must have room for size() values.
+    */
+    void distance2(const PointN<N> &point, double *out) const;
+
+    /*
+    Returns the index of the point nearest to the given one, or -1 if the set is empty.
+    If distance is not NULL, it receives the distance to that point.
+    */
+    int closest(const PointN<N> &point, double *distance = NULL) const;
+
+    /*
+    Computes the smallest box containing all points in the set, given by its lower and
+    upper corners. The set must not be empty.
+    */
+    void bounds(PointN<N> &lower, PointN<N> &upper) const;
+
+    /*
+    Returns the mean of the points in the set (the origin if the set is empty).
+    */
+    PointN<N> mean() const;
+
+    /*
+    Returns the centroid of the points in the set, each weighted by the corresponding
+    value in the weights array (the origin if all weights are zero).
+    */
+    PointN<N> centroid(const double *weights) const;
+
+    /*
+    Converts the set to a cluster of dynamic points.
+    */
+    Cluster cluster() const;
+
+    void reserve(size_t n);
+
+    void clear();
+
+    bool empty() const;
+
+    size_t size() const;
+};
+
+template<int N> clarus::PointSet<N>::PointSet() {
+    // Nothing to do.
+}
+
+template<int N> clarus::PointSet<N>::PointSet(const List<Point> &points) {
+    int n = points.size();
+    reserve(n);
+    for (int i = 0; i < n; i++) {
+        append(PointN<N>(points[i]));
+    }
+}
+
+template<int N> clarus::PointN<N> clarus::PointSet<N>::operator [] (int index) const {
+    PointN<N> point;
+    for (int k = 0; k < N; k++) {
+        point[k] = axes[k][index];
+    }
+
+    return point;
+}
+
+template<int N> void clarus::PointSet<N>::append(const PointN<N> &point) {
+    for (int k = 0; k < N; k++) {
+        axes[k].push_back(point[k]);
+    }
+}
+
+template<int N> void clarus::PointSet<N>::set(int index, const PointN<N> &point) {
+    for (int k = 0; k < N; k++) {
+        axes[k][index] = point[k];
+    }
+}
+
+template<int N> double *clarus::PointSet<N>::axis(int k) {
+    return (empty() ? NULL : &axes[k][0]);
+}
+
+template<int N> const double *clarus::PointSet<N>::axis(int k) const {
+    return (empty() ? NULL : &axes[k][0]);
+}
+
+template<int N> void clarus::PointSet<N>::distance2(const PointN<N> &point, double *out) const {
+    size_t n = size();
+    for (size_t i = 0; i < n; i++) {
+        out[i] = 0.0;
+    }
+
+    // One pass per axis keeps the inner loop free of dependencies between points.
+    for (int k = 0; k < N; k++) {
+        const double *x = axis(k);
+        double c = point[k];
+        for (size_t i = 0; i < n; i++) {
+            double delta = x[i] - c;
+            out[i] += delta * delta;
+        }
+    }
+}
+
+template<int N> int clarus::PointSet<N>::closest(const PointN<N> &point, double *distance) const {
+    size_t n = size();
+    if (n == 0) {
+        return -1;
+    }
+
+    std::vector<double> distances(n);
+    distance2(point, &distances[0]);
+
+    int nearest = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (distances[i] < distances[nearest]) {
+            nearest = i;
+        }
+    }
+
+    if (distance != NULL) {
+        *distance = std::sqrt(distances[nearest]);
+    }
+
+    return nearest;
+}
+
+template<int N> void clarus::PointSet<N>::bounds(PointN<N> &lower, PointN<N> &upper) const {
+    size_t n = size();
+    for (int k = 0; k < N; k++) {
+        const double *x = axis(k);
+        double a = DBL_MAX;
+        double b = -DBL_MAX;
+        for (size_t i = 0; i < n; i++) {
+            a = (x[i] < a ? x[i] : a);
+            b = (x[i] > b ? x[i] : b);
+        }
+
+        lower[k] = a;
+        upper[k] = b;
+    }
+}
+
+template<int N> clarus::PointN<N> clarus::PointSet<N>::mean() const {
+    PointN<N> result;
+    size_t n = size();
+    if (n == 0) {
+        return result;
+    }
+
+    for (int k = 0; k < N; k++) {
+        const double *x = axis(k);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            sum += x[i];
+        }
+
+        result[k] = sum / n;
+    }
+
+    return result;
+}
+
+template<int N> clarus::PointN<N> clarus::PointSet<N>::centroid(const double *weights) const {
+    PointN<N> result;
+    size_t n = size();
+
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        total += weights[i];
+    }
+
+    if (total == 0.0) {
+        return result;
+    }
+
+    for (int k = 0; k < N; k++) {
+        const double *x = axis(k);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            sum += x[i] * weights[i];
+        }
+
+        result[k] = sum / total;
+    }
+
+    return result;
+}
+
+template<int N> clarus::Cluster clarus::PointSet<N>::cluster() const {
+    Cluster points;
+    for (size_t i = 0, n = size(); i < n; i++) {
+        points.append((*this)[i].point());
+    }
+
+    return points;
+}
+
+template<int N> void clarus::PointSet<N>::reserve(size_t n) {
+    for (int k = 0; k < N; k++) {
+        axes[k].reserve(n);
+    }
+}
+
+template<int N> void clarus::PointSet<N>::clear() {
+    for (int k = 0; k < N; k++) {
+        axes[k].clear();
+    }
+}
+
+template<int N> bool clarus::PointSet<N>::empty() const {
+    return axes[0].empty();
+}
+
+template<int N> size_t clarus::PointSet<N>::size() const {
+    return axes[0].size();
+}
+
+#endif
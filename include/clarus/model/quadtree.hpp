@@ -20,116 +20,329 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_MODEL_QUADTREE_HPP
 #define CLARUS_MODEL_QUADTREE_HPP
 
-#include <boost/shared_ptr.hpp>
+#include <clarus/core/list.hpp>
+
+#include <boost/cstdint.hpp>
 #include <opencv2/opencv.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <queue>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
+
+/*
+Quadtree of values indexed by integer 2D points.
 
+Nodes and values are kept in contiguous pools, with the values of each leaf chained
+through an array of slot indices, and removed nodes and values recycled. The root covers
+the smallest power-of-two square containing the tree's size, so nodes always split at
+exact halves and each node covers a contiguous range of Morton (Z-order) codes. Bulk
+loading exploits this to build the tree in one pass over the values sorted by code.
+
+Besides rectangle queries, the tree answers radius and k-nearest-neighbor queries.
+Visitor-based variants of rectangle and radius queries call a function on each match
+instead of building a result list.
+*/
 template<class T> class Quadtree {
-    struct node {
-        typedef boost::shared_ptr<node> nodeP;
+public:
+    typedef std::pair<cv::Point, T> Value;
 
-        typedef clarus::List<nodeP> Children;
+    typedef clarus::List<Value> Values;
 
-        typedef std::pair<cv::Point, T> Value;
+private:
+    /* Maximum number of values in a leaf before it is split. */
+    enum { CAPACITY = 8 };
 
-        typedef clarus::List<Value> Values;
+    /* Maximum depth of node stacks used in traversals (3 pending siblings per level). */
+    enum { STACK = 3 * 32 + 1 };
 
+    struct Node {
+        /* Area covered by the node. */
         cv::Rect bounds;
 
-        Children children;
+        /* Index of the first of the node's four children in the pool, or -1 for leaves. */
+        int children;
 
-        Values values;
+        /* Index of the first value slot of a leaf, or -1 if empty. */
+        int head;
 
-        node(const cv::Rect &bounds);
+        /* Number of values in the node's subtree. */
+        int count;
 
-        bool add(const cv::Point &p, const T& value);
-
-        void query(const cv::Rect &range, Values &result) const;
+        Node(const cv::Rect &bounds);
     };
 
-    node root;
+    /* Node pool; the root is the first one. Children are allocated in blocks of four. */
+    std::vector<Node> nodes;
 
-public:
-    typedef typename node::Values Values;
+    /* First indices of free blocks of four nodes. */
+    std::vector<int> freeNodes;
+
+    /* Value pool. */
+    std::vector<Value> values;
+
+    /* Next slot in the chain of each value slot, or -1 at the end of a chain. */
+    std::vector<int> links;
+
+    /* First free value slot, or -1 if there is none. Free slots are chained through links. */
+    int freeValues;
+
+    /* Size of the indexed area. */
+    cv::Size area;
+
+    static boost::uint64_t morton(const cv::Point &point);
+
+    static boost::uint64_t spread(boost::uint32_t x);
+
+    static double distance2(const cv::Rect &bounds, const cv::Point &point);
+
+    static double distance2(const cv::Point &p0, const cv::Point &p1);
+
+    int allocate(const cv::Rect &bounds);
+
+    int slot(const cv::Point &point, const T &value);
+
+    void check(const cv::Point &point) const;
+
+    void split(int index);
+
+    void collapse(int index);
 
+    void release(int index, int &chain);
+
+    void build(int index, int begin, int end, const std::vector<boost::uint64_t> &codes);
+
+public:
+    /*
+    Creates a new tree for points within the rectangle <tt>(0, 0, size.width, size.height)</tt>.
+    */
     Quadtree(const cv::Size &size);
 
     void add(int x, int y, const T &value);
 
+    /*
+    Adds a value at the given point. Throws std::runtime_error if the point is outside
+    the tree's area.
+    */
     void add(const cv::Point &point, const T &value);
 
+    /*
+    Replaces the contents of the tree with the given values, building it bottom-up from
+    the values sorted in Morton order. This is much faster than adding values one by
+    one, and gives a tree where values close in space are also close in memory.
+    */
+    void load(const cv::Point *points, const T *values, size_t n);
+
+    void load(const Values &values);
+
+    /*
+    Removes one value equal to the given one at the given point, returning whether a
+    value was removed. Nodes left with few enough values are merged back.
+    */
+    bool remove(const cv::Point &point, const T &value);
+
+    /*
+    Removes all values at the given point, returning how many were removed.
+    */
+    int remove(const cv::Point &point);
+
+    /*
+    Removes all values from the tree.
+    */
+    void clear();
+
+    /*
+    Returns the values at points inside the given rectangle.
+    */
     Values query(const cv::Rect &range) const;
 
-    const cv::Size &size() const;
+    /*
+    Returns the values at points within distance r (inclusive) of the given center.
+    */
+    Values query(const cv::Point &center, double r) const;
+
+    /*
+    Returns the k values nearest to the given point, sorted by increasing distance.
+    */
+    Values nearest(const cv::Point &point, int k) const;
+
+    /*
+    Calls <tt>visitor(point, value)</tt> for each value at a point inside the given
+    rectangle, and returns the visitor.
+    */
+    template<class F> F visit(const cv::Rect &range, F visitor) const;
+
+    /*
+    Calls <tt>visitor(point, value)</tt> for each value at a point within distance r
+    (inclusive) of the given center, and returns the visitor.
+    */
+    template<class F> F visit(const cv::Point &center, double r, F visitor) const;
+
+    /*
+    Returns the number of values in the tree.
+    */
+    int count() const;
+
+    /*
+    Returns the size of the tree's area.
+    */
+    cv::Size size() const;
 };
 
-template<class T> Quadtree<T>::node::node(const cv::Rect &_bounds):
-    bounds(_bounds)
+template<class T> Quadtree<T>::Node::Node(const cv::Rect &_bounds):
+    bounds(_bounds),
+    children(-1),
+    head(-1),
+    count(0)
 {
     // Nothing to do.
 }
 
-template<class T> bool Quadtree<T>::node::add(const cv::Point &point, const T &value) {
-    if (!point.inside(bounds)) {
-        return false;
-    }
+template<class T> boost::uint64_t Quadtree<T>::spread(boost::uint32_t x) {
+    boost::uint64_t v = x;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2))  & 0x3333333333333333ULL;
+    v = (v | (v << 1))  & 0x5555555555555555ULL;
+    return v;
+}
 
-    if (values.size() < 4) {
-        values.append(std::make_pair(point, value));
-        return true;
+template<class T> boost::uint64_t Quadtree<T>::morton(const cv::Point &point) {
+    return spread(point.x) | (spread(point.y) << 1);
+}
+
+template<class T> double Quadtree<T>::distance2(const cv::Rect &bounds, const cv::Point &point) {
+    int x1 = bounds.x + bounds.width - 1;
+    int y1 = bounds.y + bounds.height - 1;
+    double dx = (point.x < bounds.x ? bounds.x - point.x : point.x > x1 ? point.x - x1 : 0);
+    double dy = (point.y < bounds.y ? bounds.y - point.y : point.y > y1 ? point.y - y1 : 0);
+    return dx * dx + dy * dy;
+}
+
+template<class T> double Quadtree<T>::distance2(const cv::Point &p0, const cv::Point &p1) {
+    double dx = p0.x - p1.x;
+    double dy = p0.y - p1.y;
+    return dx * dx + dy * dy;
+}
+
+template<class T> Quadtree<T>::Quadtree(const cv::Size &size):
+    freeValues(-1),
+    area(size)
+{
+    if (size.width <= 0 || size.height <= 0) {
+        throw std::runtime_error("Quadtree size must be positive");
     }
 
-    if (children.size() == 0) {
-        int xn = bounds.width;
-        int yn = bounds.height;
-        int xm = xn / 2;
-        int ym = yn / 2;
+    int side = 1;
+    while (side < size.width || side < size.height) {
+        side *= 2;
+    }
 
-        int x0 = bounds.x;
-        int y0 = bounds.y;
-        int xk = x0 + xm;
-        int yk = y0 + ym;
+    nodes.push_back(Node(cv::Rect(0, 0, side, side)));
+}
 
-        children.append().reset(new node(cv::Rect(x0, y0, xm, ym)));
-        children.append().reset(new node(cv::Rect(xk, y0, xn, ym)));
-        children.append().reset(new node(cv::Rect(x0, yk, xm, yn)));
-        children.append().reset(new node(cv::Rect(xk, yk, xn, yn)));
+template<class T> int Quadtree<T>::allocate(const cv::Rect &bounds) {
+    int x0 = bounds.x;
+    int y0 = bounds.y;
+    int half = bounds.width / 2;
+    int xk = x0 + half;
+    int yk = y0 + half;
+
+    int index = 0;
+    if (freeNodes.empty()) {
+        index = nodes.size();
+        nodes.resize(index + 4, Node(cv::Rect()));
+    }
+    else {
+        index = freeNodes.back();
+        freeNodes.pop_back();
     }
 
-    for (clarus::ListIterator<node> i(children); i.more();) {
-        nodeP &child = i.next();
-        if (child->add(point, value)) {
-            return true;
-        }
+    nodes[index + 0] = Node(cv::Rect(x0, y0, half, half));
+    nodes[index + 1] = Node(cv::Rect(xk, y0, half, half));
+    nodes[index + 2] = Node(cv::Rect(x0, yk, half, half));
+    nodes[index + 3] = Node(cv::Rect(xk, yk, half, half));
+    return index;
+}
+
+template<class T> int Quadtree<T>::slot(const cv::Point &point, const T &value) {
+    if (freeValues < 0) {
+        values.push_back(std::make_pair(point, value));
+        links.push_back(-1);
+        return values.size() - 1;
     }
 
-    throw std::runtime_error("Could not add value to tree at point " + (std::string) point);
+    int index = freeValues;
+    freeValues = links[index];
+    values[index] = std::make_pair(point, value);
+    links[index] = -1;
+    return index;
 }
 
-template<class T> void Quadtree<T>::node::query(const cv::Rect &range, Values &result) const {
-    if ((bounds & range).area() == 0) {
-        return;
+template<class T> void Quadtree<T>::check(const cv::Point &point) const {
+    if (!point.inside(cv::Rect(0, 0, area.width, area.height))) {
+        throw std::runtime_error("Could not add value to tree at point " + (std::string) point);
+    }
+}
+
+template<class T> void Quadtree<T>::split(int index) {
+    int children = allocate(nodes[index].bounds);
+    Node &node = nodes[index];
+    int xk = node.bounds.x + node.bounds.width / 2;
+    int yk = node.bounds.y + node.bounds.height / 2;
+    for (int i = node.head; i >= 0;) {
+        int next = links[i];
+        const cv::Point &point = values[i].first;
+        Node &child = nodes[children + (point.x >= xk ? 1 : 0) + (point.y >= yk ? 2 : 0)];
+        links[i] = child.head;
+        child.head = i;
+        child.count++;
+        i = next;
     }
 
-    for (clarus::ListIteratorConst<Value> i(values); i.more(); i.next()) {
-        const cv::Point &point = i->first;
-        if (point.inside(range)) {
-            result.append(*i);
+    node.head = -1;
+    node.children = children;
+
+    for (int i = 0; i < 4; i++) {
+        const Node &child = nodes[children + i];
+        if (child.count > CAPACITY && child.bounds.width > 1) {
+            split(children + i);
         }
     }
+}
+
+template<class T> void Quadtree<T>::release(int index, int &chain) {
+    Node &node = nodes[index];
+    if (node.children < 0) {
+        for (int i = node.head; i >= 0;) {
+            int next = links[i];
+            links[i] = chain;
+            chain = i;
+            i = next;
+        }
 
-    for (clarus::ListIterator<node> i(children); i.more();) {
-        nodeP &child = i.next();
-        child->query(range, result);
+        return;
     }
+
+    int children = node.children;
+    for (int i = 0; i < 4; i++) {
+        release(children + i, chain);
+    }
+
+    freeNodes.push_back(children);
 }
 
-template<class T> Quadtree<T>::Quadtree(const cv::Size &size):
-    root(cv::Rect(0, 0, size.width, size.height))
-{
-    // Nothing to do.
+template<class T> void Quadtree<T>::collapse(int index) {
+    int chain = -1;
+    release(index, chain);
+
+    Node &node = nodes[index];
+    node.children = -1;
+    node.head = chain;
 }
 
 template<class T> void Quadtree<T>::add(int x, int y, const T&value) {
@@ -137,17 +350,325 @@ template<class T> void Quadtree<T>::add(int x, int y, const T&value) {
 }
 
 template<class T> void Quadtree<T>::add(const cv::Point &point, const T &value) {
-    root.add(point, value);
+    check(point);
+
+    int index = 0;
+    for (;;) {
+        Node &node = nodes[index];
+        node.count++;
+        if (node.children < 0) {
+            break;
+        }
+
+        int xk = node.bounds.x + node.bounds.width / 2;
+        int yk = node.bounds.y + node.bounds.height / 2;
+        index = node.children + (point.x >= xk ? 1 : 0) + (point.y >= yk ? 2 : 0);
+    }
+
+    int i = slot(point, value);
+    Node &leaf = nodes[index];
+    links[i] = leaf.head;
+    leaf.head = i;
+    if (leaf.count > CAPACITY && leaf.bounds.width > 1) {
+        split(index);
+    }
+}
+
+template<class T> void Quadtree<T>::build(
+    int index,
+    int begin,
+    int end,
+    const std::vector<boost::uint64_t> &codes
+) {
+    Node &node = nodes[index];
+    node.count = end - begin;
+    if (end - begin <= CAPACITY || node.bounds.width <= 1) {
+        node.head = (begin < end ? begin : -1);
+        for (int i = begin; i < end; i++) {
+            links[i] = (i + 1 < end ? i + 1 : -1);
+        }
+
+        return;
+    }
+
+    int children = allocate(node.bounds);
+    nodes[index].children = children;
+
+    // Each quadrant covers a quarter of the node's Morton code range.
+    const cv::Rect &bounds = nodes[index].bounds;
+    boost::uint64_t base = morton(bounds.tl());
+    boost::uint64_t quarter = (boost::uint64_t) bounds.width * bounds.width / 4;
+    for (int i = 0, first = begin; i < 4; i++) {
+        boost::uint64_t limit = base + (i + 1) * quarter;
+        int last = std::lower_bound(codes.begin() + first, codes.begin() + end, limit) - codes.begin();
+        build(children + i, first, last, codes);
+        first = last;
+    }
 }
 
+/*
+Compares indices into a code array by their codes.
+*/
+struct QuadtreeCodeLess {
+    const std::vector<boost::uint64_t> &codes;
+
+    QuadtreeCodeLess(const std::vector<boost::uint64_t> &_codes):
+        codes(_codes)
+    {
+        // Nothing to do.
+    }
+
+    bool operator () (int a, int b) const {
+        return codes[a] < codes[b];
+    }
+};
+
+template<class T> void Quadtree<T>::load(const cv::Point *points, const T *data, size_t n) {
+    std::vector<boost::uint64_t> codes(n);
+    std::vector<int> order(n);
+    for (size_t i = 0; i < n; i++) {
+        check(points[i]);
+        codes[i] = morton(points[i]);
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), QuadtreeCodeLess(codes));
+
+    clear();
+    values.reserve(n);
+    links.resize(n);
+    std::vector<boost::uint64_t> sorted(n);
+    for (size_t i = 0; i < n; i++) {
+        int j = order[i];
+        values.push_back(std::make_pair(points[j], data[j]));
+        sorted[i] = codes[j];
+    }
+
+    build(0, 0, n, sorted);
+}
+
+template<class T> void Quadtree<T>::load(const Values &values) {
+    int n = values.size();
+    std::vector<cv::Point> points(n);
+    std::vector<T> data;
+    data.reserve(n);
+    for (int i = 0; i < n; i++) {
+        points[i] = values[i].first;
+        data.push_back(values[i].second);
+    }
+
+    load(n > 0 ? &points[0] : NULL, n > 0 ? &data[0] : NULL, n);
+}
+
+template<class T> bool Quadtree<T>::remove(const cv::Point &point, const T &value) {
+    if (!point.inside(cv::Rect(0, 0, area.width, area.height))) {
+        return false;
+    }
+
+    int path[STACK];
+    int depth = 0;
+    int index = 0;
+    for (;;) {
+        path[depth++] = index;
+        const Node &node = nodes[index];
+        if (node.children < 0) {
+            break;
+        }
+
+        int xk = node.bounds.x + node.bounds.width / 2;
+        int yk = node.bounds.y + node.bounds.height / 2;
+        index = node.children + (point.x >= xk ? 1 : 0) + (point.y >= yk ? 2 : 0);
+    }
+
+    Node &leaf = nodes[index];
+    for (int *link = &leaf.head; *link >= 0; link = &links[*link]) {
+        int i = *link;
+        if (values[i].first != point || !(values[i].second == value)) {
+            continue;
+        }
+
+        *link = links[i];
+        links[i] = freeValues;
+        freeValues = i;
+        values[i] = Value();
+
+        for (int j = 0; j < depth; j++) {
+            nodes[path[j]].count--;
+        }
+
+        // Merge the topmost subtree left with few enough values to fit a single leaf.
+        for (int j = 0; j < depth - 1; j++) {
+            if (nodes[path[j]].count <= CAPACITY) {
+                collapse(path[j]);
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+template<class T> int Quadtree<T>::remove(const cv::Point &point) {
+    int removed = 0;
+    Values found = query(cv::Rect(point.x, point.y, 1, 1));
+    for (int i = 0, n = found.size(); i < n; i++) {
+        removed += remove(point, found[i].second) ? 1 : 0;
+    }
+
+    return removed;
+}
+
+template<class T> void Quadtree<T>::clear() {
+    cv::Rect bounds = nodes[0].bounds;
+    nodes.assign(1, Node(bounds));
+    freeNodes.clear();
+    values.clear();
+    links.clear();
+    freeValues = -1;
+}
+
+template<class T> template<class F> F Quadtree<T>::visit(const cv::Rect &range, F visitor) const {
+    int stack[STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (node.count == 0 || (node.bounds & range).area() == 0) {
+            continue;
+        }
+
+        if (node.children >= 0) {
+            for (int i = 0; i < 4; i++) {
+                stack[top++] = node.children + i;
+            }
+
+            continue;
+        }
+
+        for (int i = node.head; i >= 0; i = links[i]) {
+            const Value &value = values[i];
+            if (value.first.inside(range)) {
+                visitor(value.first, value.second);
+            }
+        }
+    }
+
+    return visitor;
+}
+
+template<class T> template<class F> F Quadtree<T>::visit(const cv::Point &center, double r, F visitor) const {
+    double r2 = r * r;
+    int stack[STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (node.count == 0 || distance2(node.bounds, center) > r2) {
+            continue;
+        }
+
+        if (node.children >= 0) {
+            for (int i = 0; i < 4; i++) {
+                stack[top++] = node.children + i;
+            }
+
+            continue;
+        }
+
+        for (int i = node.head; i >= 0; i = links[i]) {
+            const Value &value = values[i];
+            if (distance2(value.first, center) <= r2) {
+                visitor(value.first, value.second);
+            }
+        }
+    }
+
+    return visitor;
+}
+
+/*
+Visitor that appends visited values to a list.
+*/
+template<class T> struct QuadtreeCollector {
+    clarus::List<std::pair<cv::Point, T> > values;
+
+    void operator () (const cv::Point &point, const T &value) {
+        values.append(std::make_pair(point, value));
+    }
+};
+
 template<class T> typename Quadtree<T>::Values Quadtree<T>::query(const cv::Rect &range) const {
+    return visit(range, QuadtreeCollector<T>()).values;
+}
+
+template<class T> typename Quadtree<T>::Values Quadtree<T>::query(const cv::Point &center, double r) const {
+    return visit(center, r, QuadtreeCollector<T>()).values;
+}
+
+template<class T> typename Quadtree<T>::Values Quadtree<T>::nearest(const cv::Point &point, int k) const {
+    typedef std::pair<double, int> Entry;
+
+    // Max-heap of the best k value slots found so far, by distance.
+    std::vector<Entry> best;
+
+    // Min-heap of nodes to visit, by their distance to the point.
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > pending;
+
+    if (k > 0) {
+        pending.push(Entry(0.0, 0));
+    }
+
+    while (!pending.empty()) {
+        Entry entry = pending.top();
+        pending.pop();
+        if ((int) best.size() == k && entry.first > best.front().first) {
+            break;
+        }
+
+        const Node &node = nodes[entry.second];
+        if (node.children >= 0) {
+            for (int i = 0; i < 4; i++) {
+                int child = node.children + i;
+                if (nodes[child].count > 0) {
+                    pending.push(Entry(distance2(nodes[child].bounds, point), child));
+                }
+            }
+
+            continue;
+        }
+
+        for (int i = node.head; i >= 0; i = links[i]) {
+            double d = distance2(values[i].first, point);
+            if ((int) best.size() < k) {
+                best.push_back(Entry(d, i));
+                std::push_heap(best.begin(), best.end());
+            }
+            else if (d < best.front().first) {
+                std::pop_heap(best.begin(), best.end());
+                best.back() = Entry(d, i);
+                std::push_heap(best.begin(), best.end());
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end());
+
     Values result;
-    root.query(range, result);
+    for (int i = 0, n = best.size(); i < n; i++) {
+        result.append(values[best[i].second]);
+    }
+
     return result;
 }
 
-template<class T> const cv::Size &Quadtree<T>::size() const {
-    return root.bounds.size();
+template<class T> int Quadtree<T>::count() const {
+    return nodes[0].count;
+}
+
+template<class T> cv::Size Quadtree<T>::size() const {
+    return area;
 }
 
 #endif
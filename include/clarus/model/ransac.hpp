@@ -21,10 +21,121 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #define RANSAC_HPP
 
 #include <clarus/core/list.hpp>
+#include <clarus/core/parallel.hpp>
 
 #include <opencv2/opencv.hpp>
 
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/mpl/has_xxx.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+BOOST_MPL_HAS_XXX_TRAIT_NAMED_DEF(ransac_has_batch, Batch, false)
+
+/*
+Data set laid out for residual evaluation by ransac. This default version keeps the data
+as given and calls Model::distance() on each datum.
+*/
+template<class Model, bool batched = ransac_has_batch<Model>::value> class ransac_batch {
+    typedef typename Model::Datum Datum;
+
+    /* Data set. */
+    clarus::List<Datum> data;
+
+public:
+    ransac_batch(const clarus::List<Datum> &data);
+
+    /*
+    Writes the residuals of data [begin, end) under the given model to the output array.
+    */
+    void distances(const Model &model, size_t begin, size_t end, double *out) const;
+
+    size_t size() const;
+};
+
+/*
+Data set laid out for residual evaluation by ransac, for models that declare a Batch type.
+The data are converted to that type once per fit, and residuals are computed in chunks by
+the model's distances(const Batch&, size_t begin, size_t end, double *out) method, which
+can run as a single sweep over contiguous arrays (see Line2D::Points for an example).
+Batching is opted into per model: a Batch type is only picked up if the model itself, or
+one of its bases, declares it.
+*/
+template<class Model> class ransac_batch<Model, true> {
+    typedef typename Model::Datum Datum;
+
+    /* Data set, in the model's batched layout. */
+    typename Model::Batch data;
+
+public:
+    ransac_batch(const clarus::List<Datum> &data);
+
+    /*
+    Writes the residuals of data [begin, end) under the given model to the output array.
+    */
+    void distances(const Model &model, size_t begin, size_t end, double *out) const;
+
+    size_t size() const;
+};
+
+/*
+RANSAC model fitting. Models must provide a Datum type, a fit(const List<Datum>&) method
+fitting the model to a minimal sample, a distance(const Datum&) method returning the
+residual of a datum, a distance(const Model&) method comparing models, and a public
+fitness attribute, which is set to the inlier count of fitted models. Models may also
+declare a Batch type for batched residual evaluation, see ransac_batch.
+
+Hypotheses are evaluated in parallel batches, so fit() and distance() must be safe to
+call concurrently on distinct model objects. Each hypothesis draws its sample from its
+own random stream, derived from the Options::seed and the hypothesis index, so results
+depend only on the data and options, not on the number of threads.
+*/
 template<class Model> class ransac {
+public:
+    /*
+    Fitting options.
+    */
+    struct Options {
+        /* Maximum number of hypotheses evaluated. */
+        int rounds;
+
+        /*
+        Stop once the probability of having drawn at least one all-inlier sample, estimated
+        from the inlier ratio of the best model so far, reaches this value. Values outside
+        the open interval (0, 1) disable early stopping.
+        */
+        double confidence;
+
+        /* Number of hypotheses evaluated in parallel between stopping checks. */
+        int batch;
+
+        /* Seed of the random streams used to draw samples. */
+        boost::uint64_t seed;
+
+        /*
+        Whether to score hypotheses with Wald's Sequential Probability Ratio Test (Chum and
+        Matas, "Optimal Randomized RANSAC", PAMI 30(8), 2008), which rejects bad hypotheses
+        after checking a few data points, in random order, instead of the whole data set.
+        */
+        bool sprt;
+
+        /* Initial estimate of the inlier ratio of good models, used by SPRT. */
+        double epsilon;
+
+        /* Initial estimate of the inlier ratio of bad models, used by SPRT. */
+        double delta;
+
+        /* Cost of fitting a hypothesis, in units of datum distance evaluations, used by SPRT. */
+        double cost;
+
+        explicit Options(int rounds = 1000, double confidence = 0.99);
+    };
+
+private:
     typedef clarus::List<Model> Models;
 
     typedef clarus::ListIterator<Model> ModelIterator;
@@ -37,19 +148,81 @@ template<class Model> class ransac {
 
     typedef clarus::ListIteratorConst<Datum> DataIteratorConst;
 
-    static cv::RNG rng;
+    typedef ransac_batch<Model> Batch;
+
+    /* Number of residuals computed at a time when scoring hypotheses. */
+    enum {CHUNK = 256};
+
+    /*
+    State shared by the tasks evaluating a batch of hypotheses.
+    */
+    struct Search {
+        /* Data the models are fitted to. */
+        const std::vector<Datum> &data;
+
+        /* Data laid out for scoring, shuffled if SPRT is used. */
+        const Batch &batch;
+
+        /* Whether hypotheses are scored by SPRT. */
+        bool sprt;
+
+        /* Model copied into each hypothesis before fitting. */
+        const Model &base;
+
+        /* Sample size. */
+        size_t size;
+
+        /* Inlier distance threshold. */
+        double near;
+
+        /* Seed of the random streams. */
+        boost::uint64_t seed;
+
+        /* Index of the first hypothesis in the current batch. */
+        int first;
+
+        /* SPRT likelihood ratio factors for consistent and inconsistent data, and decision threshold. */
+        double accept, reject, threshold;
+
+        /* Hypotheses of the current batch. */
+        std::vector<Model> hypotheses;
+
+        /* Inlier counts of the current batch, or -1 for hypotheses rejected by SPRT. */
+        std::vector<int> scores;
+
+        /* Number of data checked, and found consistent, for each hypothesis rejected by SPRT. */
+        std::vector<int> tested, consistent;
+
+        Search(
+            const std::vector<Datum> &data, const Batch &batch, bool sprt, const Model &base,
+            size_t size, const double &near, boost::uint64_t seed
+        );
+    };
 
     static void add(Models &models, const Model &model, const double &far);
 
-    static int fitness(const Model &model, const double &near, const Data &data);
+    static void hypothesize(const cv::Range &range, Search &search);
 
     static void next(ModelIterator &n, Models &models, const Model &model, const double &far);
 
     static void remove(Data &samples, const Model &model, const double &near);
 
-    static void sample(Data& samples, size_t n, const Data &data);
+    static void sample(Data &samples, std::vector<int> &indices, const std::vector<Datum> &data, cv::RNG &rng);
+
+    static int score(const Model &model, const Batch &batch, const double &near);
+
+    static int score(const Model &model, const Search &search, int &tested, int &consistent);
+
+    static double threshold(double epsilon, double delta, double cost);
 
 public:
+    /*
+    Fits the given model to the data by RANSAC, returning the number of hypotheses
+    evaluated. The model is replaced only by hypotheses with more inliers than it already
+    has; its fitness attribute is set to its final inlier count.
+    */
+    static int fit(Model &model, const Data &data, size_t seed, const double &near, const Options &options);
+
     static void fit(Model &model, const Data &data, int seed, const double &near, int rounds);
 
     static void fit(
@@ -64,7 +237,78 @@ public:
     );
 };
 
-template<class Model> cv::RNG ransac<Model>::rng;
+template<class Model, bool batched> ransac_batch<Model, batched>::ransac_batch(const clarus::List<Datum> &_data):
+    data(_data)
+{
+    // Nothing to do.
+}
+
+template<class Model, bool batched> void ransac_batch<Model, batched>::distances(
+    const Model &model,
+    size_t begin,
+    size_t end,
+    double *out
+) const {
+    const std::vector<Datum> &buffer = *data;
+    for (size_t i = begin; i < end; i++) {
+        *(out++) = model.distance(buffer[i]);
+    }
+}
+
+template<class Model, bool batched> size_t ransac_batch<Model, batched>::size() const {
+    return data.size();
+}
+
+template<class Model> ransac_batch<Model, true>::ransac_batch(const clarus::List<Datum> &_data):
+    data(_data)
+{
+    // Nothing to do.
+}
+
+template<class Model> void ransac_batch<Model, true>::distances(
+    const Model &model,
+    size_t begin,
+    size_t end,
+    double *out
+) const {
+    model.distances(data, begin, end, out);
+}
+
+template<class Model> size_t ransac_batch<Model, true>::size() const {
+    return data.size();
+}
+
+template<class Model> ransac<Model>::Options::Options(int _rounds, double _confidence):
+    rounds(_rounds),
+    confidence(_confidence),
+    batch(32),
+    seed(0),
+    sprt(false),
+    epsilon(0.1),
+    delta(0.01),
+    cost(200)
+{
+    // Nothing to do.
+}
+
+template<class Model> ransac<Model>::Search::Search(
+    const std::vector<Datum> &_data, const Batch &_batch, bool _sprt, const Model &_base,
+    size_t _size, const double &_near, boost::uint64_t _seed
+):
+    data(_data),
+    batch(_batch),
+    sprt(_sprt),
+    base(_base),
+    size(_size),
+    near(_near),
+    seed(_seed),
+    first(0),
+    accept(1),
+    reject(1),
+    threshold(std::numeric_limits<double>::infinity())
+{
+    // Nothing to do.
+}
 
 template<class Model> void ransac<Model>::add(Models &models, const Model &model, const double &far) {
     for (ModelIterator i(models); i.more();) {
@@ -76,6 +320,25 @@ template<class Model> void ransac<Model>::add(Models &models, const Model &model
     models.append(model);
 }
 
+template<class Model> void ransac<Model>::hypothesize(const cv::Range &range, Search &search) {
+    Data samples;
+    std::vector<int> indices(search.size);
+    for (int h = range.start; h < range.end; h++) {
+        // Derive the hypothesis' random stream from the seed and its index (SplitMix64).
+        boost::uint64_t state = search.seed + 0x9E3779B97F4A7C15ULL * (search.first + h + 1);
+        state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+        cv::RNG rng(state ^ (state >> 31));
+
+        sample(samples, indices, search.data, rng);
+        Model &model = search.hypotheses[h];
+        model = search.base;
+        model.fit(samples);
+
+        search.scores[h] = score(model, search, search.tested[h], search.consistent[h]);
+    }
+}
+
 template<class Model> void ransac<Model>::next(
     ModelIterator &n,
     Models &models,
@@ -92,64 +355,231 @@ template<class Model> void ransac<Model>::next(
 }
 
 template<class Model> void ransac<Model>::remove(Data &samples, const Model &model, const double &near) {
+    size_t n = samples.size();
+    if (n == 0) {
+        return;
+    }
+
+    std::vector<double> residuals(n);
+    Batch(samples).distances(model, 0, n, &residuals[0]);
+
     Data outliers;
-    for (DataIterator j(samples); j.more();) {
-        Datum &datum = j.next();
-        if (model.distance(datum) > near) {
-            outliers.append(datum);
+    for (size_t i = 0; i < n; i++) {
+        if (residuals[i] > near) {
+            outliers.append(samples[i]);
         }
     }
 
     samples = outliers;
 }
 
-template<class Model> int ransac<Model>::fitness(
+template<class Model> void ransac<Model>::sample(
+    Data &samples,
+    std::vector<int> &indices,
+    const std::vector<Datum> &data,
+    cv::RNG &rng
+) {
+    // Draw distinct indices; samples are small, so a linear check for repeats suffices.
+    int m = data.size();
+    samples.clear();
+    for (size_t i = 0, n = indices.size(); i < n; i++) {
+        std::vector<int>::iterator drawn = indices.begin() + i;
+        int index = 0;
+        do {
+            index = rng(m);
+        }
+        while (std::find(indices.begin(), drawn, index) != drawn);
+
+        indices[i] = index;
+        samples.append(data[index]);
+    }
+}
+
+template<class Model> int ransac<Model>::score(
     const Model &model,
-    const double &near,
-    const Data &data
+    const Batch &batch,
+    const double &near
 ) {
-    Data consensus;
-    for (DataIteratorConst i(data); i.more();) {
-        const Datum &datum = i.next();
-        if (model.distance(datum) <= near) {
-            consensus.append(datum);
+    double residuals[CHUNK];
+    int count = 0;
+    for (size_t i = 0, n = batch.size(); i < n; i += CHUNK) {
+        size_t m = std::min<size_t>(CHUNK, n - i);
+        batch.distances(model, i, i + m, residuals);
+        for (size_t j = 0; j < m; j++) {
+            if (residuals[j] <= near) {
+                count++;
+            }
         }
     }
 
-    return consensus.size();
+    return count;
 }
 
-template<class Model> void ransac<Model>::sample(Data& samples, size_t n, const Data &data) {
-    int m = data.size();
-    for (size_t i = 0; i < n; i++) {
-        int index = rng(m);
-        samples.append(data[index]);
+template<class Model> int ransac<Model>::score(
+    const Model &model,
+    const Search &search,
+    int &tested,
+    int &consistent
+) {
+    const Batch &batch = search.batch;
+    if (!search.sprt) {
+        return score(model, batch, search.near);
     }
+
+    // Residuals are still computed in chunks, and the likelihood ratio is updated
+    // datum by datum, so a rejected hypothesis wastes at most part of one chunk.
+    double residuals[CHUNK];
+    double ratio = 1.0;
+    int count = 0;
+    for (size_t i = 0, n = batch.size(); i < n; i += CHUNK) {
+        size_t m = std::min<size_t>(CHUNK, n - i);
+        batch.distances(model, i, i + m, residuals);
+        for (size_t j = 0; j < m; j++) {
+            if (residuals[j] <= search.near) {
+                ratio *= search.accept;
+                count++;
+            }
+            else {
+                ratio *= search.reject;
+            }
+
+            if (ratio > search.threshold) {
+                tested = i + j + 1;
+                consistent = count;
+                return -1;
+            }
+        }
+    }
+
+    return count;
 }
 
-template<class Model> void ransac<Model>::fit(
+template<class Model> double ransac<Model>::threshold(double epsilon, double delta, double cost) {
+    if (!(delta < epsilon)) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    // Optimal threshold for the given costs, found by fixed-point iteration.
+    double c = (1 - delta) * std::log((1 - delta) / (1 - epsilon)) + delta * std::log(delta / epsilon);
+    double k = cost * c + 1;
+    double a = k;
+    for (int i = 0; i < 10; i++) {
+        a = k + std::log(a);
+    }
+
+    return a;
+}
+
+template<class Model> int ransac<Model>::fit(
     Model &model,
     const Data &data,
-    int seed,
+    size_t seed,
     const double &near,
-    int rounds
+    const Options &options
 ) {
-    Model tentative;
-    int best = fitness(model, near, data);
-
-    for (int i = 0; i < rounds; i++) {
-        Data samples;
-        sample(samples, seed, data);
-        tentative.fit(samples);
-
-        int count = fitness(tentative, near, data);
-        if (count > best) {
-            best = count;
-            model = tentative;
+    const std::vector<Datum> &buffer = *data;
+    int n = buffer.size();
+
+    // SPRT checks data in random order, so the scoring layout is built from a shuffled copy.
+    Data shuffled = data;
+    if (options.sprt) {
+        cv::RNG rng(options.seed ^ 0xD1B54A32D192ED03ULL);
+        shuffled = data.clone();
+        for (int i = n - 1; i > 0; i--) {
+            std::swap(shuffled[i], shuffled[rng(i + 1)]);
+        }
+    }
+
+    Batch batch(shuffled);
+    int best = score(model, batch, near);
+    model.fitness = best;
+    if (seed < 1 || n < (int) seed) {
+        return 0;
+    }
+
+    Model base(model);
+    Search search(buffer, batch, options.sprt, base, seed, near, options.seed);
+
+    double epsilon = std::max(options.epsilon, best / (double) n);
+    double delta = options.delta;
+    double rejected = 0;
+    double checked = 0;
+
+    int rounds = std::max(options.rounds, 0);
+    int required = rounds;
+    int done = 0;
+    while (done < required) {
+        double a = 0;
+        if (options.sprt) {
+            a = threshold(epsilon, delta, options.cost);
+            search.accept = delta / epsilon;
+            search.reject = (1 - delta) / (1 - epsilon);
+            search.threshold = a;
+        }
+
+        int batch = std::min(std::max(options.batch, 1), required - done);
+        search.first = done;
+        search.hypotheses.resize(batch);
+        search.scores.assign(batch, 0);
+        search.tested.assign(batch, 0);
+        search.consistent.assign(batch, 0);
+        clarus::parallel::run(batch, boost::bind(hypothesize, _1, boost::ref(search)));
+        done += batch;
+
+        // Hypotheses are compared in index order, so ties are broken the same way
+        // regardless of how the batch was scheduled.
+        for (int h = 0; h < batch; h++) {
+            int count = search.scores[h];
+            if (count < 0) {
+                rejected += search.consistent[h];
+                checked += search.tested[h];
+            }
+            else if (count > best) {
+                best = count;
+                model = search.hypotheses[h];
+            }
+        }
+
+        double w = best / (double) n;
+        if (options.sprt) {
+            epsilon = std::max(epsilon, w);
+            if (checked > 0) {
+                delta = std::max(rejected / checked, 1e-6);
+            }
+        }
+
+        if (!(0 < options.confidence && options.confidence < 1)) {
+            continue;
+        }
+
+        // Good samples are found with probability w^seed, and survive SPRT with
+        // probability 1 - 1/A.
+        double p = std::pow(w, (double) seed);
+        if (options.sprt) {
+            p *= 1 - 1 / a;
+        }
+
+        if (p >= 1) {
+            required = done;
+        }
+        else if (p > 0) {
+            double k = std::ceil(std::log(1 - options.confidence) / std::log(1 - p));
+            required = (int) std::min<double>(rounds, std::max<double>(k, done));
         }
     }
 
     model.fitness = best;
+    return done;
+}
+
+template<class Model> void ransac<Model>::fit(
+    Model &model,
+    const Data &data,
+    int seed,
+    const double &near,
+    int rounds
+) {
+    fit(model, data, (size_t) seed, near, Options(rounds));
 }
 
 template<class Model> void ransac<Model>::fit(
@@ -160,7 +590,7 @@ template<class Model> void ransac<Model>::fit(
     Data samples = data;
     while (samples.size() >= seed && models.size() < upto) {
         Model model(base);
-        fit(model, samples, seed, near, rounds);
+        fit(model, samples, seed, near, Options(rounds));
         remove(samples, model, near);
         add(models, model, separation);
     }
@@ -173,7 +603,7 @@ template<class Model> void ransac<Model>::fit(
     Data samples = data;
     for (ModelIterator i(models); i.more() && samples.size() >= seed;) {
         Model &model = i.next();
-        fit(model, samples, seed, near, rounds);
+        fit(model, samples, seed, near, Options(rounds));
         remove(samples, model, near);
         next(i, models, model, separation);
     }
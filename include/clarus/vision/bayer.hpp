@@ -24,12 +24,47 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <string>
 
+/*
+Bayer mosaics are single-channel CV_8U images in BGGR layout: even rows alternate blue
+and green samples, odd rows alternate green and red samples, starting with blue at the
+top-left corner.
+*/
 namespace bayer {
+    /*
+    Samples the given BGR image into a Bayer mosaic.
+    */
     cv::Mat filter(const cv::Mat &image);
 
     cv::Mat filter(const std::string &path);
 
+    /*
+    Returns a BGR image where each pixel holds only its mosaic sample, with the other two
+    channels set to zero. Useful for visualizing mosaics; use bilinear() or adaptive() to
+    reconstruct a full color image.
+    */
     cv::Mat bgr(const cv::Mat &mosaic);
+
+    /*
+    Reconstructs a BGR image from the given mosaic by bilinear interpolation: missing
+    samples are averaged from the two or four nearest samples of the same color.
+
+    Borders are extrapolated by mirroring (as cv::BORDER_REFLECT_101), which preserves the
+    mosaic layout.
+    */
+    cv::Mat bilinear(const cv::Mat &mosaic);
+
+    /*
+    Reconstructs a BGR image from the given mosaic by edge-aware interpolation, following
+    the Hamilton-Adams method.
+
+    Green is interpolated first, along the direction (horizontal or vertical) of smaller
+    gradient, with a second-order correction from the sampled color. Red and blue are then
+    interpolated as color differences relative to green, which avoids most of the color
+    fringes bilinear interpolation produces across edges.
+
+    Borders are extrapolated by mirroring, as in bilinear().
+    */
+    cv::Mat adaptive(const cv::Mat &mosaic);
 }
 
 #endif
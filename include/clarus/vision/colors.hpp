@@ -25,6 +25,23 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #include <opencv2/opencv.hpp>
 
 namespace colors {
+    /*
+    Color components that can be extracted from BGR images by component() and
+    components(). HUE, LIGHTNESS and SATURATION are the channels of the HLS color space,
+    SATURATION_HSV and VALUE those of the HSV color space (whose hue is the same as
+    HLS's).
+    */
+    enum Component {
+        BLUE,
+        GREEN,
+        RED,
+        HUE,
+        LIGHTNESS,
+        SATURATION,
+        SATURATION_HSV,
+        VALUE
+    };
+
     /*
     Decomposes a BGR image across the channels of a panchromatic filter.
 
@@ -68,6 +85,26 @@ namespace colors {
     */
     cv::Mat merge(const cv::Mat &c1, const cv::Mat &c2, const cv::Mat &c3);
 
+    /*
+    Computes a single color component of the given BGR image.
+
+    For 8-bit BGR images, the component is computed directly from the source pixels in
+    a single pass, without converting the whole image to another color space. Results
+    match those of cv::cvtColor() (with the CV_BGR2HLS or CV_BGR2HSV codes) up to
+    rounding. Other image types are converted with cv::cvtColor().
+    */
+    cv::Mat component(const cv::Mat &bgr, Component c);
+
+    /*
+    Computes several color components of the given BGR image, returned in the order
+    they were requested.
+
+    For 8-bit BGR images all components are written in a single pass over the source,
+    and intermediate values (e.g. the minimum and maximum of each pixel) are computed
+    only once.
+    */
+    clarus::List<cv::Mat> components(const cv::Mat &bgr, const clarus::List<Component> &c);
+
     /*
     Convert the input data to unsigned single-byte type, possibly normalizing the
     input to the range [0, 255] before.
@@ -87,17 +124,20 @@ namespace colors {
     clarus::List<cv::Mat> HLS(const cv::Mat &bgr);
 
     /*
-    Converts the given BGR image to the HSL color space, hen returns its Hue channel.
+    Returns the Hue channel of the given BGR image in the HLS color space. Equivalent to
+    component(bgr, HUE).
     */
     cv::Mat hue(const cv::Mat &bgr);
 
     /*
-    Converts the given BGR image to the HSL color space, hen returns its Lightness channel.
+    Returns the Lightness channel of the given BGR image in the HLS color space. Equivalent to
+    component(bgr, LIGHTNESS).
     */
     cv::Mat lightness(const cv::Mat &bgr);
 
     /*
-    Converts the given BGR image to the HSL color space, hen returns its Saturation channel.
+    Returns the Saturation channel of the given BGR image in the HLS color space. Equivalent to
+    component(bgr, SATURATION).
     */
     cv::Mat saturation(const cv::Mat &bgr);
 }
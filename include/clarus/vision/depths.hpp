@@ -20,19 +20,73 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_VISION_DEPTHS_HPP
 #define CLARUS_VISION_DEPTHS_HPP
 
+#include <boost/smart_ptr.hpp>
+
 #include <opencv2/opencv.hpp>
 
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace depths {
     typedef float Depth;
 
-    cv::Mat load(const std::string &path);
-
-    void save(const cv::Mat &depths, const std::string &path);
-
-    void save(const cv::Mat &depths, std::ostream &out);
+    /*
+    Storage formats for depth map files.
+    */
+    enum Format {
+        /*
+        Bracketed text, one matrix row per line. Only CV_32F and CV_64F maps can be saved
+        in this format, and the scale factor is not recorded.
+        */
+        TEXT,
+
+        /*
+        Fixed-size binary header (size, type and scale) followed by the raw matrix data.
+        Frames in this format can be memory-mapped without copying (see Mapping).
+        */
+        BINARY,
+
+        /*
+        Binary header followed by the matrix data, predicted from each value's left (or
+        upper) neighbor and run-length encoded byte plane by byte plane. Compression is
+        lossless; smooth maps and large invalid regions compress best.
+        */
+        COMPRESSED
+    };
+
+    class Mapping;
+
+    class Reader;
+
+    class Writer;
+
+    /*
+    Loads a depth map from the given file. Binary and compressed files are detected by
+    their header, anything else is parsed as text. If the file contains a sequence of
+    frames, only the first is returned.
+
+    If scale is not NULL, it receives the scale factor recorded in the file (1.0 for
+    text files).
+    */
+    cv::Mat load(const std::string &path, double *scale = NULL);
+
+    /*
+    Saves a depth map to the given file, in the given format. The scale factor is a
+    free-form multiplier recorded with binary frames, usually the size of a depth unit
+    in meters (e.g. 0.001 for millimeter CV_16U maps); it is ignored by the text format.
+
+    Binary formats accept single-channel maps of type CV_16U, CV_32F or CV_64F.
+    */
+    void save(const cv::Mat &depths, const std::string &path, Format format = TEXT, double scale = 1.0);
+
+    /*
+    Writes a depth map to the given stream. Binary frames can be written one after the
+    other to the same stream to build a sequence, which can later be read frame by
+    frame with Reader or Mapping.
+    */
+    void save(const cv::Mat &depths, std::ostream &out, Format format = TEXT, double scale = 1.0);
 
     cv::Mat bgr(const cv::Mat &depths);
 
@@ -43,4 +97,99 @@ namespace depths {
     cv::Mat bgr(const cv::Mat &depths, const cv::Size &scale);
 }
 
+/*
+Memory mapping of a binary depth file, possibly holding a sequence of frames.
+
+The file is mapped copy-on-write, so BINARY frames are returned as matrices pointing
+straight into the mapping: no data is read until it is accessed, and writes to the
+matrices are never propagated back to the file. Such matrices remain valid for as long
+as the Mapping object (or any copy of it) exists. COMPRESSED frames are decoded into
+new matrices on every access.
+*/
+class depths::Mapping {
+    /* Mapped file region, released when the last copy of the mapping is destroyed. */
+    struct Region;
+
+    /* Mapped file region. */
+    boost::shared_ptr<Region> region;
+
+    /* Offsets of the headers of each frame in the file. */
+    std::vector<size_t> offsets;
+
+public:
+    /*
+    Maps the given file and indexes the frames it contains.
+    */
+    Mapping(const std::string &path);
+
+    /*
+    Returns the frame of given index.
+    */
+    cv::Mat operator [] (int index) const;
+
+    /*
+    Returns the scale factor of the frame of given index.
+    */
+    double scale(int index) const;
+
+    /*
+    Returns the number of frames in the file.
+    */
+    int size() const;
+};
+
+/*
+Sequential reader for binary depth files, which holds only one frame in memory at a
+time. Useful for long sequences or non-seekable sources.
+*/
+class depths::Reader {
+    /* Input file. */
+    std::ifstream file;
+
+    /* Compressed data buffer, reused across frames. */
+    std::vector<uchar> buffer;
+
+    /* Scale factor of the last frame read. */
+    double lastScale;
+
+public:
+    /*
+    Opens the given file for reading.
+    */
+    Reader(const std::string &path);
+
+    /*
+    Reads the next frame into the given matrix, reusing its buffer if the frame size
+    and type match. Returns false when there are no more frames.
+    */
+    bool next(cv::Mat &depths);
+
+    /*
+    Returns the scale factor of the last frame read.
+    */
+    double scale() const;
+};
+
+/*
+Sequential writer for binary depth files.
+*/
+class depths::Writer {
+    /* Output file. */
+    std::ofstream file;
+
+    /* Format of written frames. */
+    Format format;
+
+public:
+    /*
+    Creates (or truncates) the given file, for writing frames in the given format.
+    */
+    Writer(const std::string &path, Format format = BINARY);
+
+    /*
+    Appends a frame to the file.
+    */
+    void write(const cv::Mat &depths, double scale = 1.0);
+};
+
 #endif
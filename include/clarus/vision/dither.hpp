@@ -53,11 +53,16 @@ namespace dither {
         "Virtual" bit depth of the output image (or its channels if multi-channel).
         This bit depth is "virtual" in the sense that the output *type* is actually
         unsigned char (and hence 8 bits long), but the number of distinct *values*
-        returned is such that they could be indexed using this many bits.
+        returned is such that they could be indexed using this many bits. Must be
+        at most 8; a depth of 0 is treated as 1.
 
     Returns:
 
     Pixel matrix of type CV_8UC* with the values dithered down to the given bit depth.
+
+    Rows are dithered concurrently as a wavefront, each row staying at least two pixels
+    behind the one above, so the result is the same as that of the serial algorithm.
+    Use clarus::parallel::setThreads() to limit the number of threads used.
     */
     cv::Mat diffusion(const cv::Mat &image, uchar bits);
 
@@ -73,7 +78,8 @@ namespace dither {
         "Virtual" bit depth of the output image (or its channels if multi-channel).
         This bit depth is "virtual" in the sense that the output *type* is actually
         unsigned char (and hence 8 bits long), but the number of distinct *values*
-        returned is such that they could be indexed using this many bits.
+        returned is such that they could be indexed using this many bits. Must be
+        at most 8; a depth of 0 is treated as 1.
 
     Returns:
 
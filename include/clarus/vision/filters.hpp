@@ -51,6 +51,10 @@ namespace filter {
     2. Apply filter to each separate channel;
     3. Assemble result image from channel outputs.
 
+    Channels are extracted and filtered concurrently, through clarus::parallel::run().
+    Use clarus::parallel::setThreads() to cap the number of channels processed at once.
+    The filter must therefore be safe to call from several threads at the same time.
+
     Use boost::bind() to pass filter functions with extra parameters.
     */
     cv::Mat channelwise(Filter f, const cv::Mat &image);
@@ -61,6 +65,28 @@ namespace filter {
 
     cv::Mat gamma(const cv::Mat &src, double g);
 
+    /*
+    Computes the Sobel gradient magnitude of the given image in a single pass.
+
+    The 3x3 Sobel derivatives across both axes are computed from the same neighborhood
+    reads, and the magnitude sqrt(dx^2 + dy^2) is written directly to an output matrix of
+    the given type (one of CV_8U, CV_16U, CV_32F or CV_64F, saturating if needed). Borders
+    are extrapolated as cv::BORDER_REFLECT_101, as done by cv::Sobel() by default.
+
+    Multi-channel images are processed in the same pass: the output is the sum of the
+    magnitudes of all channels.
+
+    If orientation is not NULL, it receives a CV_32F matrix of gradient orientations, in
+    radians in the range [0, 2 * pi), as computed by cv::phase(). For multi-channel images
+    the orientation is taken from the channel of largest magnitude.
+    */
+    cv::Mat gradient(const cv::Mat &image, int type = CV_64F, cv::Mat *orientation = NULL);
+
+    /*
+    Computes the Sobel gradient magnitude of the given image, as a CV_8U matrix.
+
+    Multi-channel images are processed channel-wise.
+    */
     cv::Mat gradients(const cv::Mat &l);
 
     clarus::List<cv::Mat> laws(const cv::Mat &data, size_t w);
@@ -80,6 +106,10 @@ namespace filter {
 
     clarus::List<cv::Mat> prewitt(const cv::Mat &l);
 
+    /*
+    Computes the Sobel gradient magnitude of the given image, as a CV_64F matrix. For
+    multi-channel images, the magnitudes of all channels are summed.
+    */
     cv::Mat sobel(const cv::Mat &l);
 
     cv::Mat suppress(const cv::Mat &edges);
@@ -20,6 +20,8 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_VISION_GAUSSIAN_HPP
 #define CLARUS_VISION_GAUSSIAN_HPP
 
+#include <clarus/core/list.hpp>
+
 #include <opencv2/opencv.hpp>
 
 namespace gaussian {
@@ -57,6 +59,39 @@ namespace gaussian {
     Multi-channel images are processed channel-wise.
     */
     cv::Mat difference(const cv::Mat &image, double w0, double w1);
+
+    /*
+    Performs a Gaussian blur of standard deviation sigma on the input image, using the
+    recursive filter of Young and van Vliet ("Recursive implementation of the Gaussian
+    filter", Signal Processing 44, 1995).
+
+    The blur is computed as forward and backward third-order IIR passes across rows and
+    columns, so its cost does not depend on sigma. Borders are extrapolated by replicating
+    edge pixels. The approximation is accurate for sigma >= 0.5; smaller values are handed
+    over to cv::GaussianBlur().
+
+    The output is of type CV_64F, with as many channels as the input.
+    */
+    cv::Mat recursive(const cv::Mat &image, double sigma);
+
+    /*
+    Builds a Gaussian scale space of the input image.
+
+    Returns a list of n blurred images, where the i-th image has standard deviation
+    sigma0 * k^i. Each level is computed by blurring the previous one with the standard
+    deviation sqrt(sigma_(i+1)^2 - sigma_i^2), using recursive(), so the whole space costs
+    about one blur per level regardless of the scales involved.
+    */
+    clarus::List<cv::Mat> scales(const cv::Mat &image, double sigma0, double k, int n);
+
+    /*
+    Builds a Difference of Gaussians pyramid of the input image.
+
+    Returns a list of n images, where the i-th image is the difference between the
+    blurs of standard deviations sigma0 * k^i and sigma0 * k^(i + 1), as computed by
+    scales() with n + 1 levels.
+    */
+    clarus::List<cv::Mat> differences(const cv::Mat &image, double sigma0, double k, int n);
 }
 
 #endif
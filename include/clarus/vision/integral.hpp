@@ -20,6 +20,8 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_VISION_INTEGRAL_HPP
 #define CLARUS_VISION_INTEGRAL_HPP
 
+#include <clarus/core/list.hpp>
+
 #include <opencv2/opencv.hpp>
 
 #include <string>
@@ -29,6 +31,14 @@ namespace clarus
 
 /**
  * \brief Integral image and common operations.
+ *
+ * Source images must be single-channel, of type `CV_8U`, `CV_16U`, `CV_32F` or `CV_64F`.
+ * Both summed area tables are computed together in a single pass over the image.
+ *
+ * For `CV_8U` images the sum table is of type `CV_32S`, and its values are meant to be
+ * read as unsigned 32-bit integers. Entries may wrap around for large images, but sums over
+ * areas of up to 16M pixels are still exact, since they are computed in modular arithmetic.
+ * In all other cases, and for the squared sum table, entries are of type `CV_64F`.
  */
 struct Integral
 {
@@ -38,18 +48,21 @@ struct Integral
   /** \brief Summed area table of the element-wise squared image. */
   cv::Mat integral2;
 
+  /** \brief Type of the source image, or -1 if the integral image is empty. */
+  int type;
+
   /**
    * \brief Default constructor.
    */
   Integral();
 
   /**
-   * \brief Create a new integral image from the given `CV_64F` image.
+   * \brief Create a new integral image from the given image.
    */
   Integral(const cv::Mat &image);
 
   /**
-   * \brief Create a new integral image from the given `CV_64F` image.
+   * \brief Create a new integral image from the given image.
    *
    * This version of the constructor enables either the single or squared integral to be computed separately.
    */
@@ -60,6 +73,15 @@ struct Integral
    */
   bool empty() const;
 
+  /**
+   * \brief Refresh the integral image after the given area of the source image has changed.
+   *
+   * \c image is the full updated image, of the same size and type as the one the integral was
+   * created from. Only table entries below and to the right of the area's top-left corner
+   * are recomputed, so the cost is proportional to that region rather than the whole image.
+   */
+  void update(const cv::Mat &image, const cv::Rect &roi);
+
   /**
    * \brief Return the image magnitude over the given area.
    */
@@ -80,6 +102,11 @@ struct Integral
    */
   double mean(int i0, int j0, int rows, int cols) const;
 
+  /**
+   * \brief Return a `CV_64F` column vector of image means over the given areas.
+   */
+  cv::Mat mean(const List<cv::Rect> &rois) const;
+
   /**
    * \brief Return the squared image mean over the given area.
    */
@@ -100,6 +127,11 @@ struct Integral
    */
   double sum(int i0, int j0, int rows, int cols) const;
 
+  /**
+   * \brief Return a `CV_64F` column vector of image sums over the given areas.
+   */
+  cv::Mat sum(const List<cv::Rect> &rois) const;
+
   /**
    * \brief Return the squared image sum over the given area.
    */
@@ -110,6 +142,11 @@ struct Integral
    */
   double sum2(int i0, int j0, int rows, int cols) const;
 
+  /**
+   * \brief Return a `CV_64F` column vector of squared image sums over the given areas.
+   */
+  cv::Mat sum2(const List<cv::Rect> &rois) const;
+
   /**
    * \brief Return the image standard deviation over the given area.
    */
@@ -119,6 +156,18 @@ struct Integral
    * \brief Return the image standard deviation over the given area.
    */
   double standardDeviation(int i0, int j0, int rows, int cols) const;
+
+  /**
+   * \brief Return a `CV_64F` column vector of image standard deviations over the given areas.
+   */
+  cv::Mat standardDeviation(const List<cv::Rect> &rois) const;
+
+  /**
+   * \brief Compute image means and standard deviations over the given areas in a single pass.
+   *
+   * Outputs are `CV_64F` column vectors with one row per area.
+   */
+  void statistics(const List<cv::Rect> &rois, cv::Mat &means, cv::Mat &deviations) const;
 };
 
 } // namespace clarus
@@ -20,36 +20,356 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_VISION_KERNEL_HPP
 #define CLARUS_VISION_KERNEL_HPP
 
-#include <clarus/vision/fourier.hpp>
+#include <clarus/core/list.hpp>
+#include <clarus/core/parallel.hpp>
 
+#include <boost/bind.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
 #include <cstdarg>
+#include <vector>
+
+/*
+Square correlation kernel of compile-time size s.
+
+Coefficients are stored inline, so kernels can be kept in static arrays without heap
+allocation. When a kernel is built it's checked for separability, i.e. whether it's
+the outer product of a column and a row vector (a rank-1 matrix); separable kernels are
+applied as a vertical and a horizontal pass of s coefficients each, instead of a single
+pass of s * s coefficients.
+
+Kernels are applied with the same semantics as cv::filter2D() with default arguments:
+the kernel is correlated with the input (i.e. not flipped), anchored at its center, and
+borders are extrapolated with cv::BORDER_REFLECT_101. The output is always of type
+CV_64F. Single-channel inputs of type CV_8U, CV_32F and CV_64F are read directly, with
+loops specialized for the kernel size and input type; other inputs are converted to
+CV_64F first, and multi-channel inputs are handed over to cv::filter2D().
+*/
+template<size_t s> struct Kernel {
+    /* Kernel coefficients, row by row. */
+    double values[s][s];
+
+    /* Whether the kernel is the outer product of column and row. */
+    bool separable;
+
+    /* Vertical factor of separable kernels. */
+    double column[s];
+
+    /* Horizontal factor of separable kernels. */
+    double row[s];
+
+    /*
+    Creates a new kernel from an array of s * s coefficients, given row by row.
+    */
+    Kernel(const double *k);
 
-template<size_t s> struct Kernel: cv::Mat {
+    /*
+    Creates a new kernel from s * s coefficients, given row by row.
+
+    All arguments must be of type double (e.g. 1.0 instead of 1), otherwise results are
+    undefined. Prefer the array constructor.
+    */
     Kernel(double k0, ...);
 
+    /*
+    Correlates this kernel with the given data matrix.
+    */
     cv::Mat operator () (const cv::Mat &data) const;
+
+    /*
+    Returns a CV_64F matrix header over this kernel's coefficients. The header is only
+    valid as long as the kernel object exists.
+    */
+    cv::Mat mat() const;
+
+    /*
+    Correlates each of the n given kernels with the data matrix.
+
+    All kernels are applied in a single pass over the data: each neighborhood is loaded
+    once, then multiplied by every kernel. This is faster than applying the kernels one
+    at a time when several of them are not separable.
+    */
+    static clarus::List<cv::Mat> apply(const Kernel<s> *kernels, size_t n, const cv::Mat &data);
+
+private:
+    void factorize();
+
+    template<class T> void separate(
+        const cv::Mat &data,
+        cv::Mat &output,
+        const clarus::parallel::Band &band
+    ) const;
+
+    template<class T> static void correlate(
+        const Kernel<s> *kernels,
+        size_t n,
+        const cv::Mat &data,
+        std::vector<cv::Mat> &outputs,
+        const clarus::parallel::Band &band
+    );
+
+    template<class T> static void load(const T **rows, int j, int cols, double window[s][s]);
 };
 
-template<size_t s> Kernel<s>::Kernel(double k0, ...):
-    cv::Mat(s, s, CV_64F)
-{
+/*
+Maps a coordinate outside [0, n) back into it, as cv::BORDER_REFLECT_101 does.
+*/
+inline int kernel_reflect(int i, int n) {
+    if (n == 1) {
+        return 0;
+    }
+
+    while (i < 0 || i >= n) {
+        i = (i < 0 ? -i : 2 * n - 2 - i);
+    }
+
+    return i;
+}
+
+template<size_t s> Kernel<s>::Kernel(const double *k) {
+    for (size_t i = 0; i < s; i++) {
+        for (size_t j = 0; j < s; j++) {
+            values[i][j] = k[i * s + j];
+        }
+    }
+
+    factorize();
+}
+
+template<size_t s> Kernel<s>::Kernel(double k0, ...) {
     va_list args;
     va_start(args, k0);
 
-    at<double>(0, 0) = k0;
+    values[0][0] = k0;
     for (size_t i = 1, n = s * s; i < n; i++) {
-        at<double>(i / s, i % s) = va_arg(args, double);
+        values[i / s][i % s] = va_arg(args, double);
+    }
+
+    va_end(args);
+
+    factorize();
+}
+
+template<size_t s> void Kernel<s>::factorize() {
+    // Pick the largest coefficient as pivot, then take its column and row as factors.
+    size_t i_p = 0;
+    size_t j_p = 0;
+    double largest = 0.0;
+    for (size_t i = 0; i < s; i++) {
+        for (size_t j = 0; j < s; j++) {
+            double v = fabs(values[i][j]);
+            if (v > largest) {
+                largest = v;
+                i_p = i;
+                j_p = j;
+            }
+        }
+    }
+
+    double pivot = values[i_p][j_p];
+    for (size_t k = 0; k < s; k++) {
+        column[k] = values[k][j_p];
+        row[k] = (pivot != 0.0 ? values[i_p][k] / pivot : 0.0);
+    }
+
+    // The kernel is separable if the factors' outer product reproduces it.
+    double tolerance = 1e-9 * largest;
+    separable = true;
+    for (size_t i = 0; i < s && separable; i++) {
+        for (size_t j = 0; j < s && separable; j++) {
+            separable = (fabs(column[i] * row[j] - values[i][j]) <= tolerance);
+        }
+    }
+}
+
+template<size_t s> cv::Mat Kernel<s>::mat() const {
+    return cv::Mat(s, s, CV_64F, (void*) values);
+}
+
+template<size_t s> template<class T> void Kernel<s>::separate(
+    const cv::Mat &data,
+    cv::Mat &output,
+    const clarus::parallel::Band &band
+) const {
+    const int r = s / 2;
+    int rows = data.rows;
+    int cols = data.cols;
+    int i_0 = band.rows.start - r;
+    int i_n = band.rows.end + r;
+
+    // Horizontal pass over the band's rows plus r reflected rows above and below.
+    cv::Mat passed(i_n - i_0, cols, CV_64F);
+    for (int i = i_0; i < i_n; i++) {
+        const T *u = data.ptr<T>(kernel_reflect(i, rows));
+        double *v = passed.ptr<double>(i - i_0);
+        for (int j = 0; j < cols; j++) {
+            double sum = 0.0;
+            if (j >= r && j + r < cols) {
+                const T *w = u + j - r;
+                for (size_t q = 0; q < s; q++) {
+                    sum += row[q] * w[q];
+                }
+            }
+            else {
+                for (size_t q = 0; q < s; q++) {
+                    sum += row[q] * u[kernel_reflect(j - r + q, cols)];
+                }
+            }
+
+            v[j] = sum;
+        }
+    }
+
+    // Vertical pass.
+    for (int i = band.rows.start; i < band.rows.end; i++) {
+        const double *u[s];
+        for (size_t p = 0; p < s; p++) {
+            u[p] = passed.ptr<double>(i - i_0 - r + p);
+        }
+
+        double *v = output.ptr<double>(i);
+        for (int j = 0; j < cols; j++) {
+            double sum = 0.0;
+            for (size_t p = 0; p < s; p++) {
+                sum += column[p] * u[p][j];
+            }
+
+            v[j] = sum;
+        }
+    }
+}
+
+template<size_t s> template<class T> void Kernel<s>::load(const T **rows, int j, int cols, double window[s][s]) {
+    const int r = s / 2;
+    if (j >= r && j + r < cols) {
+        for (size_t p = 0; p < s; p++) {
+            const T *u = rows[p] + j - r;
+            for (size_t q = 0; q < s; q++) {
+                window[p][q] = u[q];
+            }
+        }
+    }
+    else {
+        for (size_t p = 0; p < s; p++) {
+            for (size_t q = 0; q < s; q++) {
+                window[p][q] = rows[p][kernel_reflect(j - r + q, cols)];
+            }
+        }
+    }
+}
+
+template<size_t s> template<class T> void Kernel<s>::correlate(
+    const Kernel<s> *kernels,
+    size_t n,
+    const cv::Mat &data,
+    std::vector<cv::Mat> &outputs,
+    const clarus::parallel::Band &band
+) {
+    const int r = s / 2;
+    int rows = data.rows;
+    int cols = data.cols;
+    double window[s][s];
+    for (int i = band.rows.start; i < band.rows.end; i++) {
+        const T *u[s];
+        for (size_t p = 0; p < s; p++) {
+            u[p] = data.ptr<T>(kernel_reflect(i - r + p, rows));
+        }
+
+        for (int j = 0; j < cols; j++) {
+            load<T>(u, j, cols, window);
+            for (size_t k = 0; k < n; k++) {
+                const double (&values)[s][s] = kernels[k].values;
+                double sum = 0.0;
+                for (size_t p = 0; p < s; p++) {
+                    for (size_t q = 0; q < s; q++) {
+                        sum += values[p][q] * window[p][q];
+                    }
+                }
+
+                outputs[k].ptr<double>(i)[j] = sum;
+            }
+        }
     }
 }
 
 template<size_t s> cv::Mat Kernel<s>::operator () (const cv::Mat &data) const {
-    cv::Mat input;
-    data.convertTo(input, CV_64F);
+    if (!separable) {
+        return apply(this, 1, data)[0];
+    }
 
-    cv::Mat output;
-    cv::filter2D(input, output, -1, *((cv::Mat*) this));
+    if (data.channels() > 1) {
+        cv::Mat input;
+        data.convertTo(input, CV_64F);
+
+        cv::Mat output;
+        cv::filter2D(input, output, -1, mat());
+        return output;
+    }
+
+    cv::Mat output(data.size(), CV_64F);
+    switch (data.depth()) {
+        case CV_8U:
+            clarus::parallel::bands(data.rows, s / 2, boost::bind(&Kernel<s>::template separate<uchar>, this, boost::cref(data), boost::ref(output), _1));
+            break;
+
+        case CV_32F:
+            clarus::parallel::bands(data.rows, s / 2, boost::bind(&Kernel<s>::template separate<float>, this, boost::cref(data), boost::ref(output), _1));
+            break;
+
+        case CV_64F:
+            clarus::parallel::bands(data.rows, s / 2, boost::bind(&Kernel<s>::template separate<double>, this, boost::cref(data), boost::ref(output), _1));
+            break;
+
+        default: {
+            cv::Mat input;
+            data.convertTo(input, CV_64F);
+            return (*this)(input);
+        }
+    }
 
     return output;
 }
 
+template<size_t s> clarus::List<cv::Mat> Kernel<s>::apply(const Kernel<s> *kernels, size_t n, const cv::Mat &data) {
+    clarus::List<cv::Mat> outputs;
+    if (data.channels() > 1) {
+        cv::Mat input;
+        data.convertTo(input, CV_64F);
+        for (size_t k = 0; k < n; k++) {
+            cv::Mat output;
+            cv::filter2D(input, output, -1, kernels[k].mat());
+            outputs.append(output);
+        }
+
+        return outputs;
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        outputs.append(cv::Mat(data.size(), CV_64F));
+    }
+
+    switch (data.depth()) {
+        case CV_8U:
+            clarus::parallel::bands(data.rows, s / 2, boost::bind(correlate<uchar>, kernels, n, boost::cref(data), boost::ref(*outputs), _1));
+            break;
+
+        case CV_32F:
+            clarus::parallel::bands(data.rows, s / 2, boost::bind(correlate<float>, kernels, n, boost::cref(data), boost::ref(*outputs), _1));
+            break;
+
+        case CV_64F:
+            clarus::parallel::bands(data.rows, s / 2, boost::bind(correlate<double>, kernels, n, boost::cref(data), boost::ref(*outputs), _1));
+            break;
+
+        default: {
+            cv::Mat input;
+            data.convertTo(input, CV_64F);
+            return apply(kernels, n, input);
+        }
+    }
+
+    return outputs;
+}
+
 #endif
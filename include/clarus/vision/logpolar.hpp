@@ -23,6 +23,8 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #include <opencv2/opencv.hpp>
 
 namespace logpolar {
+    class Mapper;
+
     /*
     Returns the log-polar transform of the input image.
 
@@ -47,14 +49,126 @@ namespace logpolar {
     Returns:
 
     The log-polar transform for the input image.
+
+    Calling this function is equivalent to creating a Mapper for the image's geometry and
+    applying it once. Code that repeatedly transforms images of the same geometry (e.g.
+    video frames) should keep a Mapper object instead, so the lookup table is reused.
     */
     cv::Mat transform(
         const cv::Mat &image,
         int i_0 = -1, int j_0 = -1,
         int p_n = -1, int t_n = -1,
-        bool side = false
+        bool slide = false
     );
 }
+
+/*
+Log-polar mapping with a precomputed lookup table.
+
+The sampling coordinates of every output cell are computed once, when the object is
+created, and stored relative to the transform's center. Moving the center only adds the
+new center to the stored offsets, so the transcendental functions are never evaluated
+again. Transforms are applied with cv::remap(), using either nearest-neighbor or bilinear
+interpolation.
+
+The radial scale of the transform is fixed at construction time, from the distance
+between the initial center and the farthest image corner. Recentering does not change
+it, so transforms taken at different centers remain comparable.
+*/
+class logpolar::Mapper {
+    /* Size of the input images. */
+    cv::Size input;
+
+    /* Interpolation method, either cv::INTER_NEAREST or cv::INTER_LINEAR. */
+    int interpolation;
+
+    /* Sampling coordinates relative to the center, as (x, y) pairs of type CV_32FC2. */
+    cv::Mat offsets;
+
+    /* Fixed-point remap tables for the current center, as computed by cv::convertMaps(). */
+    cv::Mat map1;
+
+    cv::Mat map2;
+
+    /* Current center of the transform, as a (column, row) point. */
+    cv::Point origin;
+
+public:
+    /*
+    Creates a new empty mapper.
+    */
+    Mapper();
+
+    /*
+    Creates a new mapper for images of the given size.
+
+    Arguments:
+
+    size
+        Size of the input images.
+
+    i_0, j0
+        Optional. The center of the transform. If omitted, the center of the input image
+        is used.
+
+    p_n, t_n
+        Optional. Dimensions of the output transform. If omitted, the same defaults as
+        transform() are used.
+
+    interpolation
+        Optional. Either cv::INTER_NEAREST (the default) or cv::INTER_LINEAR.
+    */
+    Mapper(
+        const cv::Size &size,
+        int i_0 = -1, int j_0 = -1,
+        int p_n = -1, int t_n = -1,
+        int interpolation = cv::INTER_NEAREST
+    );
+
+    /*
+    Virtual destructor. Enforces polymorphism. Do not remove.
+    */
+    virtual ~Mapper();
+
+    /*
+    Returns the log-polar transform of the given image.
+
+    If slide is true, the transform is slided vertically until the uppermost non-blank
+    pixel touches the top image border, while the bottom region is filled with blank
+    pixels.
+
+    The image must be of the size given to the constructor.
+    */
+    cv::Mat operator () (const cv::Mat &image, bool slide = false) const;
+
+    /*
+    Computes the log-polar transform of the given image into the given output matrix.
+
+    The output matrix is reallocated only if its size or type does not match the
+    transform's, so the same buffer can be reused across calls.
+    */
+    void operator () (const cv::Mat &image, cv::Mat &lp, bool slide = false) const;
+
+    /*
+    Moves the transform's center to the given coordinates.
+    */
+    void recenter(int i_0, int j_0);
+
+    /*
+    Returns whether this mapper is empty.
+    */
+    bool empty() const;
+
+    /*
+    Returns the current center of the transform, as a (column, row) point.
+    */
+    cv::Point center() const;
+
+    /*
+    Returns the size of the input images.
+    */
+    cv::Size size() const;
+};
 /*
 template<class T> cv::Mat logpolar::transform(const cv::Mat &image, int i_0, int j_0, int p_n, int t_n) {
     // Original image dimensions.
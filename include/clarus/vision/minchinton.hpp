@@ -20,6 +20,9 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #ifndef CLARUS_VISION_MINCHINTON_HPP
 #define CLARUS_VISION_MINCHINTON_HPP
 
+#include <clarus/core/parallel.hpp>
+
+#include <boost/bind.hpp>
 #include <opencv2/opencv.hpp>
 
 namespace minchinton {
@@ -28,41 +31,60 @@ namespace minchinton {
     template<class T> cv::Mat filter2d(const cv::Mat &data, size_t w);
 
     cv::Mat bgr(const cv::Mat &data);
-}
 
-template<class T> cv::Mat minchinton::filter2d(const cv::Mat &data) {
-    size_t rows = data.rows;
-    size_t cols = data.cols;
+    /*
+    Band bodies used by the parallel implementations of filter2d(). Not meant to be
+    called directly.
+    */
+    template<class T> void filter2d_band(const cv::Mat &data, cv::Mat &cells, const clarus::parallel::Band &band);
 
-    size_t i_n = rows - 1;
-    size_t j_n = cols - 1;
+    template<class T> void filter2d_band(const cv::Mat &data, size_t w, cv::Mat &cells, const clarus::parallel::Band &band);
+}
 
-    cv::Mat cells(data.size(), CV_8U);
-    for (size_t i_1 = 0; i_1 < rows; i_1++) {
-        for (size_t j_1 = 0; j_1 < cols; j_1++) {
-            size_t i_2 = (i_1 < i_n ? i_1 + 1 : 0);
-            size_t j_2 = (j_1 < j_n ? j_1 + 1 : 0);
-
-            T t = data.at<T>(i_1, j_1);
-            bool bigger = (
-                t > data.at<T>(i_1, j_2) &&
-                t > data.at<T>(i_2, j_1) &&
-                t > data.at<T>(i_2, j_2)
-            );
-
-            cells.at<uchar>(i_1, j_1) = (bigger ? 255 : 0);
+template<class T> void minchinton::filter2d_band(
+    const cv::Mat &data,
+    cv::Mat &cells,
+    const clarus::parallel::Band &band
+) {
+    int rows = data.rows;
+    int j_n = data.cols - 1;
+
+    for (int i_1 = band.rows.start; i_1 < band.rows.end; i_1++) {
+        // Neighbors past the last row or column wrap around to the first.
+        int i_2 = (i_1 < rows - 1 ? i_1 + 1 : 0);
+        const T *row_1 = data.ptr<T>(i_1);
+        const T *row_2 = data.ptr<T>(i_2);
+        uchar *cell = cells.ptr<uchar>(i_1);
+
+        for (int j_1 = 0; j_1 < j_n; j_1++) {
+            T t = row_1[j_1];
+            bool bigger = (t > row_1[j_1 + 1] && t > row_2[j_1] && t > row_2[j_1 + 1]);
+            cell[j_1] = (bigger ? 255 : 0);
         }
-    }
 
-    return cells;
+        T t = row_1[j_n];
+        bool bigger = (t > row_1[0] && t > row_2[j_n] && t > row_2[0]);
+        cell[j_n] = (bigger ? 255 : 0);
+    }
 }
 
-template<class T> cv::Mat minchinton::filter2d(const cv::Mat &data, size_t w) {
+template<class T> cv::Mat minchinton::filter2d(const cv::Mat &data) {
     cv::Mat cells(data.size(), CV_8U);
+    clarus::parallel::bands(data.rows, 1, boost::bind(filter2d_band<T>, boost::cref(data), boost::ref(cells), _1));
+    return cells;
+}
 
+template<class T> void minchinton::filter2d_band(
+    const cv::Mat &data,
+    size_t w,
+    cv::Mat &cells,
+    const clarus::parallel::Band &band
+) {
     size_t u = w / 2;
-    for (size_t i = 0, m = data.rows; i < m; i++) {
-        for (size_t j = 0, n = data.cols; j < n; j++) {
+    for (size_t i = band.rows.start, m = data.rows, i_n = band.rows.end; i < i_n; i++) {
+        const T *value = data.ptr<T>(i);
+        uchar *cell = cells.ptr<uchar>(i);
+        for (size_t j = 0, n = data.cols; j < n; j++, value++, cell++) {
             size_t x = (j < u ? j : j - u);
             size_t y = (i < u ? i : i - u);
             size_t width = (x + w > n ? n - x : w);
@@ -71,18 +93,22 @@ template<class T> cv::Mat minchinton::filter2d(const cv::Mat &data, size_t w) {
             cv::Rect roi(x, y, width, height);
             cv::Mat patch(data, roi);
 
+            // Statistics are always returned as CV_64F values.
             cv::Mat mean;
             cv::Mat stdev;
             cv::meanStdDev(patch, mean, stdev);
 
-            T val = data.at<T>(i, j);
-            T avg = mean.at<T>(0);
-            T std = stdev.at<T>(0);
+            double avg = mean.at<double>(0);
+            double std = stdev.at<double>(0);
 
-            cells.at<uchar>(i, j) = (fabs(val - avg) > std ? 255 : 0);
+            *cell = (fabs(*value - avg) > std ? 255 : 0);
         }
     }
+}
 
+template<class T> cv::Mat minchinton::filter2d(const cv::Mat &data, size_t w) {
+    cv::Mat cells(data.size(), CV_8U);
+    clarus::parallel::bands(data.rows, w / 2, boost::bind(filter2d_band<T>, boost::cref(data), w, boost::ref(cells), _1));
     return cells;
 }
 
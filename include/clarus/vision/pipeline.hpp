@@ -0,0 +1,306 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLARUS_VISION_PIPELINE_HPP
+#define CLARUS_VISION_PIPELINE_HPP
+
+#include <clarus/core/parallel.hpp>
+#include <clarus/vision/filters.hpp>
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+namespace pipeline {
+    class Graph;
+
+    /*
+    Identifier of a node in a pipeline graph.
+    */
+    typedef int Node;
+}
+
+/*
+Lazily evaluated graph of image filters.
+
+Nodes are added through the methods below, each of which takes the node(s) providing its
+input and returns the identifier of the new node. The graph's input image is always node
+INPUT. Since nodes can only refer to previously created nodes, the graph is acyclic by
+construction. Nothing is computed until the graph is run on an image.
+
+Before the first run the graph is compiled into a sequence of steps:
+
+1. Runs of pointwise nodes (gamma, scale, threshold, compress, discrete) are fused into a
+   single pass, as long as the intermediate results are not used anywhere else. Global
+   nodes (normalize, equalize, normalizing discrete) compute their parameters from a
+   single reduction pass over their input, then fuse with the pointwise nodes that
+   follow them;
+2. Fused passes apply all their operations to one row segment at a time, with segments
+   short enough to stay in cache. Rows are split in bands processed concurrently through
+   clarus::parallel::bands();
+3. Intermediate results are assigned buffers from a pool, where a buffer is returned as
+   soon as its last reader has run, and pointwise passes write over their input when
+   possible.
+
+Buffers are kept between runs, so applying the same graph to a sequence of images of the
+same size (e.g. video frames) does not allocate memory after the first frame, except for
+nodes wrapping arbitrary filter functions.
+
+All computations are done in double precision (CV_64F), except for the output of discrete
+nodes, which is of type CV_8U. Inputs must be single-channel; use filter::channelwise()
+with a separate graph per channel to process multi-channel images.
+
+Results are available only for nodes marked as outputs. The last node added to the graph
+is always an output.
+*/
+class pipeline::Graph {
+    /* Node kinds. */
+    enum Kind {
+        SOURCE,
+        GAMMA,
+        SCALE,
+        THRESHOLD,
+        COMPRESS,
+        DISCRETE,
+        NORMALIZE,
+        EQUALIZE,
+        BLUR,
+        DIFFERENCE,
+        CUSTOM
+    };
+
+    /* Description of a node, as given by the user. */
+    struct Vertex {
+        Kind kind;
+
+        Node source;
+
+        double p0;
+
+        double p1;
+
+        int type;
+
+        filter::Filter f;
+
+        bool output;
+    };
+
+    /* Pointwise operation codes. */
+    enum Code {
+        POW,
+        LOG,
+        AFFINE,
+        CLAMP,
+        TANH
+    };
+
+    /* Pointwise operation, applied in sequence to rows of a fused pass. */
+    struct Op {
+        Code code;
+
+        double p0;
+
+        double p1;
+
+        int type;
+    };
+
+    /* Compiled step of the graph. */
+    struct Step {
+        /* Kind of the step's head node. */
+        Kind kind;
+
+        /* Node read by the step. */
+        Node source;
+
+        /* Last node computed by the step, whose value it stores. */
+        Node node;
+
+        /* Parameters of the head node. */
+        double p0;
+
+        double p1;
+
+        filter::Filter f;
+
+        /* Pointwise operations applied by fused passes. */
+        std::vector<Op> ops;
+
+        /* Depth of the step's output, or -1 if unknown until run time. */
+        int depth;
+
+        /* Index of the buffer the step writes to. */
+        int slot;
+
+        /* Input converted to CV_64F, when the source is of another type. */
+        cv::Mat converted;
+
+        /* Second blur of difference steps. */
+        cv::Mat blurred;
+
+        /* Partial sums of reduction passes, one pair per row. */
+        std::vector<double> sums;
+    };
+
+    /* Nodes in order of creation. */
+    std::vector<Vertex> vertices;
+
+    /* Compiled steps, or an empty list if the graph has changed since last compiled. */
+    std::vector<Step> steps;
+
+    /* Buffer pool, reused across runs. */
+    std::vector<cv::Mat> buffers;
+
+    /* Buffer holding each node's value, or -1 if it isn't materialized. */
+    std::vector<int> slots;
+
+    /* Input of the last run. */
+    cv::Mat image;
+
+    Node add(Kind kind, Node source, double p0 = 0, double p1 = 0, int type = 0);
+
+    void compile();
+
+    const cv::Mat &value(Node node) const;
+
+    void execute(Step &step);
+
+    void fuse(Step &step);
+
+    void reduce(Step &step);
+
+    static void apply(const std::vector<Op> &ops, double *values, int n);
+
+    static void fuse_band(
+        const cv::Mat &source,
+        cv::Mat &target,
+        const std::vector<Op> &ops,
+        const clarus::parallel::Band &band
+    );
+
+public:
+    /* Identifier of the graph's input node. */
+    static const Node INPUT = 0;
+
+    /*
+    Creates a new graph containing only the input node.
+    */
+    Graph();
+
+    /*
+    Virtual destructor. Enforces polymorphism. Do not remove.
+    */
+    virtual ~Graph();
+
+    /*
+    Pointwise gamma correction, with the same semantics as filter::gamma(): values are
+    raised to the power g if g > 0, otherwise log(x + 1) is computed.
+    */
+    Node gamma(Node source, double g);
+
+    /*
+    Pointwise linear transform a * x + b.
+    */
+    Node scale(Node source, double a, double b = 0);
+
+    /*
+    Pointwise threshold, with the same semantics as cv::threshold() for the types
+    cv::THRESH_BINARY, cv::THRESH_BINARY_INV, cv::THRESH_TRUNC, cv::THRESH_TOZERO and
+    cv::THRESH_TOZERO_INV.
+    */
+    Node threshold(Node source, double t, double value = 1.0, int type = cv::THRESH_BINARY);
+
+    /*
+    Pointwise soft clipping t * tanh(x / t).
+    */
+    Node compress(Node source, double t);
+
+    /*
+    Min-max normalization of values to the range [lower, upper], with the same semantics
+    as cv::normalize() with the CV_MINMAX norm.
+    */
+    Node normalize(Node source, double lower, double upper);
+
+    /*
+    Conversion to CV_8U, with the same semantics as colors::discrete(): values are first
+    min-max normalized to the range [0, 255] if normalize is true.
+    */
+    Node discrete(Node source, bool normalize = true);
+
+    /*
+    Tan-Triggs contrast equalization: values are divided by the means of |x|^a and
+    min(|x|, t)^a (each raised to 1 / a), then soft-clipped to (-t, t).
+    */
+    Node equalize(Node source, double a = 0.1, double t = 10.0);
+
+    /*
+    Gaussian blur, with the same semantics as gaussian::blur(image, w).
+    */
+    Node blur(Node source, double w);
+
+    /*
+    Difference of Gaussians, with the same semantics as gaussian::difference().
+    */
+    Node difference(Node source, double w0, double w1);
+
+    /*
+    Arbitrary filter function. Its output is not pooled, and is converted to CV_64F when
+    read by other nodes.
+    */
+    Node filter(Node source, filter::Filter f);
+
+    /*
+    Tan-Triggs illumination normalization, with the same semantics as filter::tantriggs().
+    Adds the gamma, difference, equalize and discrete nodes it's composed of, and returns
+    the last one.
+    */
+    Node tantriggs(
+        Node source,
+        double a = 0.1,
+        double t = 10.0,
+        double g = 0.2,
+        double w0 = 1.0,
+        double w1 = 2.0
+    );
+
+    /*
+    Marks the given node as an output, so its value is kept after the graph is run.
+    */
+    void output(Node node);
+
+    /*
+    Runs the graph on the given image. Returns the value of the last node added to the
+    graph, which remains valid until the graph is run again.
+    */
+    const cv::Mat &operator () (const cv::Mat &image);
+
+    /*
+    Returns the value computed for the given output node in the last run. The returned
+    matrix is overwritten when the graph is run again; clone it to keep it longer.
+    */
+    const cv::Mat &operator [] (Node node) const;
+
+    /*
+    Returns the number of nodes in the graph, including the input node.
+    */
+    int size() const;
+};
+
+#endif
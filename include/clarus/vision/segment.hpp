@@ -22,10 +22,95 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <opencv2/opencv.hpp>
 
+#include <vector>
+
 namespace segment {
+    class KMeans;
+
     cv::Mat blob(const cv::Mat &data, float threshold);
 
+    /*
+    Segments the image by clustering its pixel colors, and returns an image of the same
+    type where each pixel is replaced by the color of its cluster's center.
+
+    This is a one-shot use of KMeans, see that class for details. To segment a video,
+    keep a KMeans object across frames instead, so the centers found in one frame are
+    the starting point for the next.
+    */
     cv::Mat kmeans(const cv::Mat &image, int cluster_number = 10);
 }
 
+/*
+Stateful k-means color segmenter for 8-bit images of 1 to 4 channels.
+
+Centers are initialized on the first image by running cv::kmeans() (with k-means++
+seeding) on a random sample of pixels. Every call to update() then refines them with
+mini-batch steps (Sculley, "Web-scale k-means clustering", WWW 2010): a few batches of
+random pixels are drawn, each pixel is assigned to its nearest center, and the center is
+moved towards it by a step inversely proportional to the number of pixels it absorbed.
+These counts are halved at the start of every update, so older frames are gradually
+forgotten and the centers follow changes in the scene.
+
+Labels are assigned on the 8-bit data, using integer distances to the centers rounded to
+8 bits, over parallel bands of rows.
+*/
+class segment::KMeans {
+    /* Number of clusters. */
+    int k;
+
+    /* Number of pixels sampled per mini-batch. */
+    int batch;
+
+    /* Number of mini-batches per update. */
+    int iterations;
+
+    /* Cluster centers, one per row, as a CV_32F matrix. */
+    cv::Mat means;
+
+    /* Number of pixels absorbed by each center, used as the inverse learning rate. */
+    std::vector<float> counts;
+
+    /* Random number generator used for sampling pixels. */
+    cv::RNG rng;
+
+    /* Initializes the centers from a sample of the given image. */
+    void initialize(const cv::Mat &image);
+
+public:
+    /*
+    Creates a new segmenter for the given number of clusters, mini-batch size and
+    number of mini-batches per update.
+    */
+    KMeans(int clusters = 10, int batch = 256, int iterations = 4);
+
+    /*
+    Updates the centers and returns the segmented image, where each pixel is replaced by
+    the color of its nearest center.
+    */
+    cv::Mat operator () (const cv::Mat &image);
+
+    /*
+    Updates the centers from the given image. Centers are reinitialized if this is the
+    first image, or if its number of channels differs from that of the previous one.
+    */
+    void update(const cv::Mat &image);
+
+    /*
+    Returns a CV_32S matrix with the index of the center nearest to each pixel of the
+    given image, without updating the centers.
+    */
+    cv::Mat labels(const cv::Mat &image) const;
+
+    /*
+    Returns the centers rounded to 8 bits, as a k x 1 matrix with as many channels as
+    the segmented images. The matrix is empty if no image was seen yet.
+    */
+    cv::Mat palette() const;
+
+    /*
+    Discards the current centers, so they are reinitialized on the next update.
+    */
+    void reset();
+};
+
 #endif
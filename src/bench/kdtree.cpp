@@ -0,0 +1,232 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Compares KDTree queries, and the cluster distance built on them, against brute-force
+scans over the same points, reporting times and checking that results agree.
+
+Usage: clarus_bench_kdtree [points [queries [dimension]]]
+
+Defaults to 20000 random points, 1000 queries, and dimension 3.
+*/
+
+#include <clarus/model/cluster.hpp>
+#include <clarus/model/kdtree.hpp>
+#include <clarus/model/point.hpp>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+using clarus::Cluster;
+using clarus::KDTree;
+using clarus::List;
+using clarus::Point;
+
+typedef std::vector<std::pair<double, int> > Ranking;
+
+/* Number of neighbors returned by k-NN queries. */
+static const int K = 8;
+
+/* Error bound of approximate queries. */
+static const double EPSILON = 0.5;
+
+/* Maximum number of points split between the two clusters. */
+static const int CLUSTER_POINTS = 5000;
+
+static double now() {
+    return 1000.0 * cv::getTickCount() / cv::getTickFrequency();
+}
+
+static Point random_point(cv::RNG &rng, size_t dimension, double side) {
+    List<double> coordinates;
+    for (size_t k = 0; k < dimension; k++) {
+        coordinates.append(rng.uniform(0.0, side));
+    }
+
+    return Point(coordinates);
+}
+
+static void fill(cv::RNG &rng, List<Point> &points, int n, size_t dimension, double side) {
+    for (int i = 0; i < n; i++) {
+        points.append(random_point(rng, dimension, side));
+    }
+}
+
+static int brute_radius(const List<Point> &points, const Point &p, double r) {
+    int count = 0;
+    for (int i = 0, n = points.size(); i < n; i++) {
+        if (clarus::distance(points[i], p) <= r) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void brute_nearest(const List<Point> &points, const Point &p, int k, Ranking &ranking) {
+    ranking.clear();
+    for (int i = 0, n = points.size(); i < n; i++) {
+        ranking.push_back(std::make_pair(clarus::distance(points[i], p), i));
+    }
+
+    k = std::min<int>(k, ranking.size());
+    std::partial_sort(ranking.begin(), ranking.begin() + k, ranking.end());
+    ranking.resize(k);
+}
+
+static double brute_distance(const Cluster &c1, const Cluster &c2) {
+    double d = std::numeric_limits<double>::max();
+    for (int i = 0, m = c1.size(); i < m; i++) {
+        for (int j = 0, n = c2.size(); j < n; j++) {
+            d = std::min(d, clarus::distance(c1[i], c2[j]));
+        }
+    }
+
+    return d;
+}
+
+static void report(const char *name, double brute, double indexed, int mismatches) {
+    printf("%-28s%12.2f%12.2f%10.1fx%12d\n", name, brute, indexed, brute / indexed, mismatches);
+}
+
+int main(int argc, char *argv[]) {
+    int n = (argc > 1 ? atoi(argv[1]) : 20000);
+    int q = (argc > 2 ? atoi(argv[2]) : 1000);
+    int dimension = (argc > 3 ? atoi(argv[3]) : 3);
+    if (n < K || q < 1 || dimension < 1) {
+        fprintf(stderr, "Usage: %s [points [queries [dimension]]]\n", argv[0]);
+        return 1;
+    }
+
+    // Points are spread in a cube sized so a unit ball holds about 10 points on average.
+    double side = std::pow(n / 10.0, 1.0 / dimension);
+    double r = 1.0;
+
+    cv::RNG rng(0);
+    List<Point> points;
+    List<Point> queries;
+    fill(rng, points, n, dimension, side);
+    fill(rng, queries, q, dimension, side);
+
+    double start = now();
+    KDTree index(points);
+    double built = now() - start;
+
+    printf("%d points, %d queries, dimension %d; build %.2f ms\n\n", n, q, dimension, built);
+    printf("%-28s%12s%12s%11s%12s\n", "query", "brute (ms)", "tree (ms)", "speedup", "mismatches");
+
+    // Radius search.
+    std::vector<int> counts(q);
+    start = now();
+    for (int i = 0; i < q; i++) {
+        counts[i] = brute_radius(points, queries[i], r);
+    }
+
+    double brute = now() - start;
+    int mismatches = 0;
+    start = now();
+    for (int i = 0; i < q; i++) {
+        if ((int) index.radius(queries[i], r).size() != counts[i]) {
+            mismatches++;
+        }
+    }
+
+    report("radius", brute, now() - start, mismatches);
+
+    // Exact k-NN: compare the distance of the k-th neighbor, as ties may reorder indices.
+    std::vector<double> kth(q);
+    Ranking ranking;
+    start = now();
+    for (int i = 0; i < q; i++) {
+        brute_nearest(points, queries[i], K, ranking);
+        kth[i] = ranking.back().first;
+    }
+
+    brute = now() - start;
+    std::vector<List<int> > found(q);
+    start = now();
+    for (int i = 0; i < q; i++) {
+        found[i] = index.nearest(queries[i], K);
+    }
+
+    double indexed = now() - start;
+    mismatches = 0;
+    for (int i = 0; i < q; i++) {
+        if (found[i].size() != (size_t) K) {
+            mismatches++;
+        }
+        else if (std::fabs(clarus::distance(points[found[i][K - 1]], queries[i]) - kth[i]) > 1e-9) {
+            mismatches++;
+        }
+    }
+
+    report("k-NN", brute, indexed, mismatches);
+
+    // Approximate k-NN: count queries whose k-th neighbor exceeds the error bound.
+    start = now();
+    for (int i = 0; i < q; i++) {
+        found[i] = index.nearest(queries[i], K, EPSILON);
+    }
+
+    indexed = now() - start;
+    mismatches = 0;
+    double error = 0;
+    for (int i = 0; i < q; i++) {
+        if (found[i].size() != (size_t) K) {
+            mismatches++;
+            continue;
+        }
+
+        double d = clarus::distance(points[found[i][K - 1]], queries[i]);
+        error += d / kth[i] - 1;
+        if (d > (1 + EPSILON) * kth[i] + 1e-9) {
+            mismatches++;
+        }
+    }
+
+    report("approximate k-NN", brute, indexed, mismatches);
+    printf("%-28smean k-th neighbor error %.3f%% (bound %.0f%%)\n", "", 100 * error / q, 100 * EPSILON);
+
+    // Cluster distance, between the even- and odd-indexed halves of (at most) the first
+    // CLUSTER_POINTS points, since the brute-force version is quadratic.
+    Cluster c1;
+    Cluster c2;
+    for (int i = 0, m = std::min(n, CLUSTER_POINTS); i < m; i++) {
+        (i % 2 == 0 ? c1 : c2).append(points[i]);
+    }
+
+    start = now();
+    double expected = brute_distance(c1, c2);
+    brute = now() - start;
+
+    start = now();
+    double d = clarus::distance(c1, c2);
+    indexed = now() - start;
+    report("distance(Cluster, Cluster)", brute, indexed, (std::fabs(d - expected) > 1e-9 ? 1 : 0));
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Times the kernels ported to clarus::parallel on a 1080p frame, with the number of
+threads capped from 1 up to N through parallel::setThreads(), and reports the speedup
+of each over its single-threaded time.
+
+Usage: clarus_bench_parallel [N [repetitions]]
+
+N defaults to the number of CPUs, and repetitions to 10.
+*/
+
+#include <clarus/core/math.hpp>
+#include <clarus/core/parallel.hpp>
+#include <clarus/vision/bayer.hpp>
+#include <clarus/vision/fourier.hpp>
+#include <clarus/vision/gaussian.hpp>
+#include <clarus/vision/images.hpp>
+#include <clarus/vision/minchinton.hpp>
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/*
+Input frames shared by the benchmarked kernels.
+*/
+struct Frames {
+    /* Random 1080p BGR frame. */
+    cv::Mat bgr;
+
+    /* Second BGR frame, differing from the first by noise. */
+    cv::Mat noisy;
+
+    /* Grayscale version of the BGR frame. */
+    cv::Mat gray;
+
+    /* Bayer mosaic of the BGR frame. */
+    cv::Mat mosaic;
+
+    /* Binary cell map of the grayscale frame. */
+    cv::Mat cells;
+
+    /* Fourier transform of the grayscale frame. */
+    cv::Mat spectrum;
+
+    Frames();
+};
+
+Frames::Frames():
+    bgr(1080, 1920, CV_8UC3),
+    noisy(1080, 1920, CV_8UC3)
+{
+    cv::RNG rng(0);
+    rng.fill(bgr, cv::RNG::UNIFORM, 0, 256);
+    rng.fill(noisy, cv::RNG::UNIFORM, 0, 16);
+    noisy += bgr;
+
+    cv::cvtColor(bgr, gray, CV_BGR2GRAY);
+    mosaic = bayer::filter(bgr);
+    cells = minchinton::filter2d<uchar>(gray);
+
+    cv::Mat samples;
+    gray.convertTo(samples, CV_64F);
+    spectrum = fourier::transform(samples);
+}
+
+typedef void (*Kernel)(const Frames &frames);
+
+static void bayer_filter(const Frames &frames) {
+    bayer::filter(frames.bgr);
+}
+
+static void bayer_bgr(const Frames &frames) {
+    bayer::bgr(frames.mosaic);
+}
+
+static void minchinton_filter2d(const Frames &frames) {
+    minchinton::filter2d<uchar>(frames.gray);
+}
+
+static void minchinton_filter2d_w(const Frames &frames) {
+    minchinton::filter2d<uchar>(frames.gray, 5);
+}
+
+static void minchinton_bgr(const Frames &frames) {
+    minchinton::bgr(frames.cells);
+}
+
+static void fourier_bgr(const Frames &frames) {
+    fourier::bgr(frames.spectrum);
+}
+
+static void images_difference(const Frames &frames) {
+    images::difference(frames.bgr, frames.noisy);
+}
+
+static void math_mean(const Frames &frames) {
+    clarus::mean(frames.bgr, 0);
+}
+
+static void gaussian_recursive(const Frames &frames) {
+    gaussian::recursive(frames.bgr, 4.0);
+}
+
+/*
+Returns the mean time in milliseconds of the given number of runs of a kernel, after one
+untimed warm-up run.
+*/
+static double measure(Kernel kernel, const Frames &frames, int repetitions) {
+    kernel(frames);
+
+    int64 start = cv::getTickCount();
+    for (int i = 0; i < repetitions; i++) {
+        kernel(frames);
+    }
+
+    int64 ticks = cv::getTickCount() - start;
+    return 1000.0 * ticks / (cv::getTickFrequency() * repetitions);
+}
+
+int main(int argc, char *argv[]) {
+    int threads = (argc > 1 ? atoi(argv[1]) : cv::getNumberOfCPUs());
+    int repetitions = (argc > 2 ? atoi(argv[2]) : 10);
+    if (threads < 1 || repetitions < 1) {
+        fprintf(stderr, "Usage: %s [threads [repetitions]]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    std::vector<Kernel> kernels;
+    names.push_back("bayer::filter");         kernels.push_back(bayer_filter);
+    names.push_back("bayer::bgr");            kernels.push_back(bayer_bgr);
+    names.push_back("minchinton::filter2d");  kernels.push_back(minchinton_filter2d);
+    names.push_back("minchinton::filter2d w"); kernels.push_back(minchinton_filter2d_w);
+    names.push_back("minchinton::bgr");       kernels.push_back(minchinton_bgr);
+    names.push_back("fourier::bgr");          kernels.push_back(fourier_bgr);
+    names.push_back("images::difference");    kernels.push_back(images_difference);
+    names.push_back("clarus::mean");          kernels.push_back(math_mean);
+    names.push_back("gaussian::recursive");   kernels.push_back(gaussian_recursive);
+
+    Frames frames;
+
+    printf("1920x1080 frames, %d repetitions, times in ms (speedup over 1 thread)\n\n", repetitions);
+    printf("%-24s", "kernel");
+    for (int t = 1; t <= threads; t++) {
+        printf("%16d", t);
+    }
+
+    printf("\n");
+
+    for (int k = 0, n = kernels.size(); k < n; k++) {
+        printf("%-24s", names[k].c_str());
+        double serial = 0;
+        for (int t = 1; t <= threads; t++) {
+            clarus::parallel::setThreads(t);
+            double elapsed = measure(kernels[k], frames, repetitions);
+            if (t == 1) {
+                serial = elapsed;
+            }
+
+            printf("%9.2f (%4.1fx)", elapsed, serial / elapsed);
+        }
+
+        printf("\n");
+    }
+
+    clarus::parallel::setThreads(0);
+    return 0;
+}
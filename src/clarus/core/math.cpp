@@ -19,9 +19,12 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/core/math.hpp>
 #include <clarus/core/matrix.hpp>
+#include <clarus/core/parallel.hpp>
 #include <clarus/vision/colors.hpp>
 #include <clarus/vision/images.hpp>
 
+#include <boost/bind.hpp>
+
 #include <cmath>
 
 namespace clarus
@@ -196,6 +199,17 @@ double mean(const cv::Mat &data)
   return total / ((double) n);
 }
 
+static void collapse_band(const cv::Mat &data, cv::Mat &collapsed, const parallel::Band &band)
+{
+  for (int i = band.rows.start, n = data.cols; i < band.rows.end; i++)
+  {
+    const cv::Vec3b *u = data.ptr<cv::Vec3b>(i);
+    double *v = collapsed.ptr<double>(i);
+    for (int j = 0; j < n; j++, u++, v++)
+      *v = (*u)[0] + (*u)[1] + (*u)[2];
+  }
+}
+
 static cv::Mat collapse(const cv::Mat &data)
 {
   int count = data.channels();
@@ -205,10 +219,7 @@ static cv::Mat collapse(const cv::Mat &data)
   cv::Mat collapsed(data.size(), CV_64F, cv::Scalar(0.0));
   if (count == 3 && data.type() == CV_8UC3)
   {
-    double *v = (double*) collapsed.data;
-    cv::Vec3b *u = (cv::Vec3b*) data.data;
-    for (int i = 0, n = data.rows * data.cols; i < n; i++, u++, v++)
-      *v = (*u)[0] + (*u)[1] + (*u)[2];
+    parallel::bands(data.rows, 0, boost::bind(collapse_band, boost::cref(data), boost::ref(collapsed), _1));
   }
   else
   {
@@ -0,0 +1,116 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <clarus/core/parallel.hpp>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+namespace clarus
+{
+
+namespace parallel
+{
+
+/** \brief Maximum number of concurrent tasks, or a value lower than 1 for no cap. */
+static int threads_ = 0;
+
+/** \brief Number of bands (or run() chunks) created per worker thread, for load balancing. */
+static const int BANDS_PER_THREAD = 4;
+
+/** \brief Minimum band height, to keep per-task overhead low on small matrices. */
+static const int BAND_MIN_ROWS = 8;
+
+/**
+ * \brief Adapter between loop bodies and OpenCV's parallel loop interface.
+ */
+class Loop: public cv::ParallelLoopBody
+{
+  const Body &body_;
+
+public:
+  Loop(const Body &body):
+    body_(body)
+  {
+    // Nothing to do.
+  }
+
+  virtual void operator () (const cv::Range &range) const
+  {
+    body_(range);
+  }
+};
+
+void setThreads(int n)
+{
+  threads_ = n;
+}
+
+int threads()
+{
+  return threads_;
+}
+
+int workers()
+{
+  return (threads_ > 0 ? threads_ : cv::getNumberOfCPUs());
+}
+
+void run(int n, Body body)
+{
+  if (n < 1)
+    return;
+
+  int cap = threads_;
+  if (n == 1 || cap == 1)
+  {
+    body(cv::Range(0, n));
+    return;
+  }
+
+  // Without a cap, create a few chunks per CPU rather than one per index, so bodies that
+  // loop over elements still get contiguous runs of them.
+  double stripes = (cap > 1 ? std::min(n, cap) : std::min(n, workers() * BANDS_PER_THREAD));
+  cv::parallel_for_(cv::Range(0, n), Loop(body), stripes);
+}
+
+static void band_task(int rows, int halo, int count, const BandBody &body, const cv::Range &range)
+{
+  for (int k = range.start; k < range.end; k++)
+  {
+    Band band;
+    band.rows = cv::Range(rows * k / count, rows * (k + 1) / count);
+    band.halo = cv::Range(std::max(0, band.rows.start - halo), std::min(rows, band.rows.end + halo));
+    body(band);
+  }
+}
+
+void bands(int rows, int halo, BandBody body)
+{
+  if (rows < 1)
+    return;
+
+  int count = std::max(1, std::min(rows / BAND_MIN_ROWS, workers() * BANDS_PER_THREAD));
+  run(count, boost::bind(band_task, rows, halo, count, boost::cref(body), _1));
+}
+
+} // namespace parallel
+
+} // namespace clarus
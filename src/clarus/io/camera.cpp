@@ -72,6 +72,11 @@ void Camera::Driver::loop() {
 
             camera.read(frame);
 
+            // Raw frames may be delivered as a flat buffer.
+            if (rawSize.area() > 0 && frame.rows == 1 && (int) frame.total() == rawSize.area()) {
+                frame = frame.reshape(0, rawSize.height);
+            }
+
             cv::VideoWriter *recorder = videoRecorder.get();
             if (recorder != NULL) {
                 recorder->write(frame);
@@ -132,6 +137,16 @@ cv::Size Camera::Driver::size() {
     return cv::Size(width, height);
 }
 
+bool Camera::Driver::raw(bool enabled) {
+    boost::unique_lock<boost::shared_mutex> locked(lock);
+    if (!camera.set(CV_CAP_PROP_CONVERT_RGB, enabled ? 0.0 : 1.0)) {
+        return false;
+    }
+
+    rawSize = (enabled ? size() : cv::Size());
+    return true;
+}
+
 double Camera::Driver::get(int id) {
     return camera.get(id);
 }
@@ -220,6 +235,13 @@ cv::Size Camera::size() {
     return driver->size();
 }
 
+bool Camera::raw(bool enabled) {
+    if (!opened()) {
+        throw std::runtime_error("Cannot change capture mode of a closed camera");
+    }
+
+    return driver->raw(enabled);
+}
 
 double Camera::get(int id) {
     if (!opened()) {
@@ -0,0 +1,502 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <clarus/model/assignment.hpp>
+using clarus::Assigner;
+using clarus::Assignment;
+using clarus::SparseCosts;
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+using std::vector;
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+Assignment::Assignment():
+    cost(0)
+{
+    // Nothing to do.
+}
+
+int Assignment::size() const {
+    int n = 0;
+    for (int i = 0, m = rows.size(); i < m; i++) {
+        if (rows[i] >= 0) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/*
+Solves the assignment of n rows to m >= n columns. Rows are added one at a time: a
+Dijkstra search over reduced costs c(i, j) - u(i) - v(j), rooted at the new row, finds
+the shortest alternating path to a free column, and the path is flipped. Dual variables
+are updated as the search grows, so reduced costs stay non-negative and are zero on
+assigned pairs.
+
+Forbidden pairs are given a cost large enough that any solution using fewer of them is
+cheaper, so every row is assigned and the caller drops the forbidden pairs afterwards.
+This maximizes the number of allowed pairs first, and minimizes their cost second.
+
+Arrays are 1-based, with index 0 standing for the virtual root of each search.
+*/
+template<class T> static void solve(const cv::Mat &costs, vector<int> &row_of) {
+    int n = costs.rows;
+    int m = costs.cols;
+
+    double lowest = INF;
+    double highest = -INF;
+    for (int i = 0; i < n; i++) {
+        const T *row = costs.ptr<T>(i);
+        for (int j = 0; j < m; j++) {
+            double c = row[j];
+            if (c < INF) {
+                lowest = std::min(lowest, c);
+                highest = std::max(highest, c);
+            }
+        }
+    }
+
+    double forbidden = (lowest < INF ? highest + (n + 1) * (highest - lowest + 1) : 0);
+
+    vector<double> u(n + 1, 0.0);
+    vector<double> v(m + 1, 0.0);
+    vector<int> way(m + 1, 0);
+    vector<double> shortest(m + 1);
+    vector<char> used(m + 1);
+
+    // row_of[j] is the row assigned to column j, or 0.
+    row_of.assign(m + 1, 0);
+    for (int i = 1; i <= n; i++) {
+        row_of[0] = i;
+        int j0 = 0;
+        std::fill(shortest.begin(), shortest.end(), INF);
+        std::fill(used.begin(), used.end(), false);
+
+        do {
+            used[j0] = true;
+            int i0 = row_of[j0];
+            const T *row = costs.ptr<T>(i0 - 1) - 1;
+            double delta = INF;
+            int j1 = 0;
+            for (int j = 1; j <= m; j++) {
+                if (used[j]) {
+                    continue;
+                }
+
+                // Infinite and NaN costs mark forbidden pairs.
+                double c = row[j];
+                double reduced = (c < INF ? c : forbidden) - u[i0] - v[j];
+                if (reduced < shortest[j]) {
+                    shortest[j] = reduced;
+                    way[j] = j0;
+                }
+
+                if (shortest[j] < delta) {
+                    delta = shortest[j];
+                    j1 = j;
+                }
+            }
+
+            for (int j = 0; j <= m; j++) {
+                if (used[j]) {
+                    u[row_of[j]] += delta;
+                    v[j] -= delta;
+                }
+                else {
+                    shortest[j] -= delta;
+                }
+            }
+
+            j0 = j1;
+        }
+        while (row_of[j0] != 0);
+
+        // Flip the alternating path back to the root.
+        do {
+            int j1 = way[j0];
+            row_of[j0] = row_of[j1];
+            j0 = j1;
+        }
+        while (j0 != 0);
+    }
+}
+
+Assignment clarus::assign(const cv::Mat &costs) {
+    int depth = costs.depth();
+    if (costs.channels() != 1 || (depth != CV_32F && depth != CV_64F)) {
+        throw std::runtime_error("Assignment costs must be a single-channel CV_32F or CV_64F matrix");
+    }
+
+    // The solver expects no more rows than columns, so taller problems are transposed.
+    bool transposed = (costs.rows > costs.cols);
+    cv::Mat problem = (transposed ? cv::Mat(costs.t()) : costs);
+
+    vector<int> row_of;
+    if (depth == CV_32F) {
+        solve<float>(problem, row_of);
+    }
+    else {
+        solve<double>(problem, row_of);
+    }
+
+    Assignment assignment;
+    assignment.rows.assign(costs.rows, -1);
+    assignment.cols.assign(costs.cols, -1);
+    for (int j = 1, m = problem.cols; j <= m; j++) {
+        int i = row_of[j];
+        if (i == 0) {
+            continue;
+        }
+
+        int row = (transposed ? j - 1 : i - 1);
+        int col = (transposed ? i - 1 : j - 1);
+        double cost = (depth == CV_32F ? costs.at<float>(row, col) : costs.at<double>(row, col));
+        if (!(cost < INF)) {
+            continue;
+        }
+
+        assignment.rows[row] = col;
+        assignment.cols[col] = row;
+        assignment.cost += cost;
+    }
+
+    return assignment;
+}
+
+SparseCosts::Candidate::Candidate(int _col, double _cost):
+    col(_col),
+    cost(_cost)
+{
+    // Nothing to do.
+}
+
+SparseCosts::SparseCosts(int rows, int cols):
+    m(cols),
+    candidates(rows)
+{
+    // Nothing to do.
+}
+
+const vector<SparseCosts::Candidate> &SparseCosts::operator [] (int row) const {
+    return candidates[row];
+}
+
+void SparseCosts::add(int row, int col, double cost) {
+    if (row < 0 || row >= rows() || col < 0 || col >= m) {
+        throw std::runtime_error(
+            (boost::format("Invalid pair (%1%, %2%) for %3% x %4% costs") % row % col % rows() % m).str()
+        );
+    }
+
+    if (cost < INF) {
+        candidates[row].push_back(Candidate(col, cost));
+    }
+}
+
+void SparseCosts::clear() {
+    for (int i = 0, n = candidates.size(); i < n; i++) {
+        candidates[i].clear();
+    }
+}
+
+void SparseCosts::resize(int rows, int cols) {
+    m = cols;
+    candidates.resize(rows);
+    clear();
+}
+
+int SparseCosts::rows() const {
+    return candidates.size();
+}
+
+int SparseCosts::cols() const {
+    return m;
+}
+
+Assigner::Assigner():
+    kept(0),
+    augmented(0)
+{
+    // Nothing to do.
+}
+
+/*
+Each row i gets a private "reserve" column m + i, standing for leaving the row unassigned
+at a cost larger than any combination of allowed pairs could save. Every row is then
+assigned, and the problem is solved in the same dual form as solve() above: reduced costs
+c(i, j) - u(i) - v(j) are non-negative, zero on assigned pairs, and column duals are zero
+on free columns and non-positive elsewhere.
+*/
+Assignment Assigner::operator () (const SparseCosts &costs) {
+    typedef SparseCosts::Candidate Candidate;
+    typedef std::pair<double, int> Entry;
+
+    int n = costs.rows();
+    int m = costs.cols();
+
+    double lowest = INF;
+    double highest = -INF;
+    for (int i = 0; i < n; i++) {
+        const vector<Candidate> &row = costs[i];
+        for (int k = 0, K = row.size(); k < K; k++) {
+            lowest = std::min(lowest, row[k].cost);
+            highest = std::max(highest, row[k].cost);
+        }
+    }
+
+    double reserve = (lowest < INF ? highest + (n + 1) * (highest - lowest + 1) : 0);
+    double tolerance = 1e-9 * (lowest < INF ? highest - lowest + 1 : 1);
+
+    // Restore the previous duals, shifted so none is positive.
+    vector<double> v(m + n, 0.0);
+    for (int j = 0, k = std::min<int>(m, prices.size()); j < k; j++) {
+        v[j] = prices[j];
+    }
+
+    for (int i = 0, k = std::min<int>(n, reserves.size()); i < k; i++) {
+        v[m + i] = reserves[i];
+    }
+
+    double top = (v.empty() ? 0 : *std::max_element(v.begin(), v.end()));
+    for (int j = 0, k = v.size(); j < k && top > 0; j++) {
+        v[j] -= top;
+    }
+
+    // Restore previous pairs that are still candidates.
+    vector<int> col_of(n, -1);
+    vector<int> row_of(m + n, -1);
+    vector<double> paid(n, 0.0);
+    for (int i = 0, k = std::min<int>(n, previous.size()); i < k; i++) {
+        int j = previous[i];
+        if (j >= m) {
+            continue;
+        }
+
+        if (j < 0) {
+            col_of[i] = m + i;
+            paid[i] = reserve;
+        }
+        else if (row_of[j] < 0) {
+            const vector<Candidate> &row = costs[i];
+            for (int l = 0, L = row.size(); l < L; l++) {
+                if (row[l].col == j) {
+                    col_of[i] = j;
+                    paid[i] = row[l].cost;
+                    break;
+                }
+            }
+        }
+
+        if (col_of[i] >= 0) {
+            row_of[col_of[i]] = i;
+        }
+    }
+
+    for (int j = 0, k = v.size(); j < k; j++) {
+        if (row_of[j] < 0) {
+            v[j] = 0;
+        }
+    }
+
+    // Row duals are set to the smallest reduced cost on each row. Restored pairs that
+    // are no longer tight are dropped; as this zeroes the dual of their column, which
+    // may in turn loosen other pairs, repeat until no more pairs are dropped.
+    vector<double> u(n);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 0; i < n; i++) {
+            const vector<Candidate> &row = costs[i];
+            double smallest = reserve - v[m + i];
+            for (int k = 0, K = row.size(); k < K; k++) {
+                smallest = std::min(smallest, row[k].cost - v[row[k].col]);
+            }
+
+            u[i] = smallest;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int j = col_of[i];
+            if (j < 0) {
+                continue;
+            }
+
+            if (paid[i] - v[j] - u[i] > tolerance) {
+                row_of[j] = -1;
+                col_of[i] = -1;
+                v[j] = 0;
+                changed = true;
+            }
+        }
+    }
+
+    kept = 0;
+    for (int i = 0; i < n; i++) {
+        int j = col_of[i];
+        if (j >= 0) {
+            u[i] = paid[i] - v[j];
+            kept++;
+        }
+    }
+
+    // Augment the remaining rows one at a time, by a Dijkstra search over reduced costs.
+    vector<double> shortest(m + n, INF);
+    vector<double> edge(m + n, 0.0);
+    vector<int> way(m + n, -1);
+    vector<char> done(m + n, false);
+    vector<int> touched;
+    vector<int> scanned;
+    std::priority_queue<Entry, vector<Entry>, std::greater<Entry> > heap;
+
+    augmented = 0;
+    for (int r = 0; r < n; r++) {
+        if (col_of[r] >= 0) {
+            continue;
+        }
+
+        augmented++;
+        int i = r;
+        int from = -1;
+        double base = 0;
+        int sink = -1;
+        for (;;) {
+            const vector<Candidate> &row = costs[i];
+            for (int k = 0, K = row.size(); k <= K; k++) {
+                int j = (k < K ? row[k].col : m + i);
+                if (done[j]) {
+                    continue;
+                }
+
+                double c = (k < K ? row[k].cost : reserve);
+                double distance = base + c - u[i] - v[j];
+                if (distance < shortest[j]) {
+                    if (shortest[j] == INF) {
+                        touched.push_back(j);
+                    }
+
+                    shortest[j] = distance;
+                    edge[j] = c;
+                    way[j] = from;
+                    heap.push(Entry(distance, j));
+                }
+            }
+
+            // The root's reserve column is always free and reachable, so the heap never
+            // runs out before a free column is found.
+            int j = -1;
+            while (j < 0) {
+                Entry entry = heap.top();
+                heap.pop();
+                if (!done[entry.second] && entry.first == shortest[entry.second]) {
+                    j = entry.second;
+                }
+            }
+
+            if (row_of[j] < 0) {
+                sink = j;
+                break;
+            }
+
+            done[j] = true;
+            scanned.push_back(j);
+            i = row_of[j];
+            from = j;
+            base = shortest[j];
+        }
+
+        // Update duals so reduced costs stay non-negative and the path becomes tight.
+        double length = shortest[sink];
+        u[r] += length;
+        for (int k = 0, K = scanned.size(); k < K; k++) {
+            int j = scanned[k];
+            double delta = length - shortest[j];
+            v[j] -= delta;
+            u[row_of[j]] += delta;
+        }
+
+        // Flip the alternating path back to the root.
+        for (int j = sink; j >= 0;) {
+            int p = way[j];
+            int i = (p < 0 ? r : row_of[p]);
+            row_of[j] = i;
+            col_of[i] = j;
+            paid[i] = edge[j];
+            j = p;
+        }
+
+        for (int k = 0, K = touched.size(); k < K; k++) {
+            int j = touched[k];
+            shortest[j] = INF;
+            way[j] = -1;
+            done[j] = false;
+        }
+
+        touched.clear();
+        scanned.clear();
+        while (!heap.empty()) {
+            heap.pop();
+        }
+    }
+
+    Assignment assignment;
+    assignment.rows.assign(n, -1);
+    assignment.cols.assign(m, -1);
+    previous.assign(n, -1);
+    for (int i = 0; i < n; i++) {
+        int j = col_of[i];
+        if (j >= m) {
+            continue;
+        }
+
+        assignment.rows[i] = j;
+        assignment.cols[j] = i;
+        assignment.cost += paid[i];
+        previous[i] = j;
+    }
+
+    prices.assign(v.begin(), v.begin() + m);
+    reserves.assign(v.begin() + m, v.end());
+
+    return assignment;
+}
+
+int Assigner::augmentations() const {
+    return augmented;
+}
+
+int Assigner::carried() const {
+    return kept;
+}
+
+void Assigner::reset() {
+    prices.clear();
+    reserves.clear();
+    previous.clear();
+    kept = 0;
+    augmented = 0;
+}
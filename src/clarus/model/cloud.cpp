@@ -23,6 +23,9 @@ using clarus::Cloud;
 using clarus::Cluster;
 using clarus::ListIteratorConst;
 
+#include <clarus/model/kdtree.hpp>
+using clarus::KDTree;
+
 Cloud::Cloud():
     List<Cluster>()
 {
@@ -47,23 +50,22 @@ const Cluster &Cloud::closest() const {
     return at(j);
 }
 
-static bool no_close_matches(const clarus::Point &p, const clarus::Cloud &b, double t2) {
-    for (ListIteratorConst<Cluster> j(b); j.more();) {
-        const Cluster &v = j.next();
-        if (distance2(p, v.center()) <= t2) {
-            return false;
-        }
-    }
-
-    return true;
+static bool no_close_matches(const clarus::Point &p, const KDTree &centers, double t) {
+    return centers.radius(p, t).empty();
 }
 
 Cloud clarus::difference(const Cloud &a, const Cloud &b, double t) {
+    // Index the centers of B once, instead of recomputing them for every cluster in A.
+    clarus::List<clarus::Point> centers;
+    for (ListIteratorConst<Cluster> j(b); j.more();) {
+        centers.append(j.next().center());
+    }
+
     Cloud c;
-    double t2 = t * t;
+    KDTree index(centers);
     for (ListIteratorConst<Cluster> i(a); i.more();) {
         const Cluster &u = i.next();
-        if (no_close_matches(u.center(), b, t2)) {
+        if (no_close_matches(u.center(), index, t)) {
             c.append(u);
         }
     }
@@ -21,6 +21,9 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 using clarus::Cluster;
 using clarus::Point;
 
+#include <clarus/model/kdtree.hpp>
+using clarus::KDTree;
+
 #include <boost/bind.hpp>
 
 #include <cmath>
@@ -135,6 +138,23 @@ double clarus::distance(const Cluster &cluster) {
 
 double clarus::distance(const Cluster &c1, const Cluster &c2) {
     double d = std::numeric_limits<double>::max();
+
+    // Index the larger cluster and query it with the points of the smaller one, unless
+    // the clusters are small enough that a brute-force search is cheaper.
+    if (c1.size() * c2.size() > 256) {
+        const Cluster &queries = (c1.size() < c2.size() ? c1 : c2);
+        KDTree index(c1.size() < c2.size() ? c2 : c1);
+        for (ListIteratorConst<Point> i(queries); i.more();) {
+            double e = d;
+            index.closest(i.next(), &e);
+            if (e < d) {
+                d = e;
+            }
+        }
+
+        return d;
+    }
+
     for (ListIteratorConst<Point> i(c1); i.more();) {
         const Point &p1 = i.next();
         for (ListIteratorConst<Point> j(c2); j.more();) {
@@ -23,74 +23,379 @@ using clarus::Cluster;
 using clarus::List;
 using clarus::Point;
 
+#include <clarus/core/parallel.hpp>
+
+#include <clarus/model/kdtree.hpp>
+using clarus::KDTree;
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
 #include <vector>
 using std::vector;
 
-static List<int> query(const List<Point> &points, const Point &p, double e2) {
-    clarus::List<int> keys;
+typedef boost::int64_t Key;
+
+/*
+Spatial index over a point list, answering neighborhood queries of fixed radius.
+*/
+class Neighborhood {
+public:
+    virtual ~Neighborhood() {
+        // Nothing to do.
+    }
+
+    /*
+    Fills keys with the indices of the points within the query radius of the i-th point,
+    in ascending order.
+    */
+    virtual void query(int i, vector<int> &keys) const = 0;
+
+    /*
+    Returns the memory used by the index, in bytes.
+    */
+    virtual size_t memory() const = 0;
+};
+
+/*
+Uniform grid of cells as wide as the query radius, so the neighbors of a point are always
+in its own cell or the ones adjacent to it. Points are sorted by cell, and each query
+looks up the 3^d cells around the point by binary search.
+*/
+class Grid: public Neighborhood {
+    /* Dimension of the indexed space. */
+    size_t d;
+
+    /* Squared query radius. */
+    double e2;
+
+    /* Point coordinates, d per point. */
+    vector<double> coords;
+
+    /* Cell key of each point. */
+    vector<Key> cells;
+
+    /* Point indices, sorted by cell key. */
+    vector<int> order;
+
+    /* Cell keys, in the same order as the order array. */
+    vector<Key> sorted;
+
+    /* Key offsets from a cell to itself and all its adjacent cells. */
+    vector<Key> adjacent;
+
+    /* Whether all cells could be assigned distinct keys. */
+    bool keyed;
+
+    struct KeyLess {
+        const vector<Key> &cells;
+
+        KeyLess(const vector<Key> &_cells):
+            cells(_cells)
+        {
+            // Nothing to do.
+        }
+
+        bool operator () (int a, int b) const {
+            return cells[a] < cells[b];
+        }
+    };
+
+public:
+    Grid(const List<Point> &points, size_t _d, double _e2):
+        d(_d),
+        e2(_e2),
+        keyed(false)
+    {
+        // Cells are made slightly wider than the radius, so rounding errors never push
+        // a neighbor beyond the adjacent cells.
+        static const double LIMIT = 1099511627776.0; // 2^40
+        double width = std::sqrt(e2) * (1.0 + 1e-6);
+
+        int n = points.size();
+        coords.assign(n * d, 0.0);
+        vector<double> lower(d, LIMIT);
+        vector<double> upper(d, -LIMIT);
+        for (int i = 0; i < n; i++) {
+            const Point &p = points[i];
+            for (size_t k = 0; k < d; k++) {
+                double x = (k < p.dimension() ? p[k] : 0.0);
+                double c = std::floor(x / width);
+                if (!(-LIMIT <= c && c <= LIMIT)) {
+                    return;
+                }
+
+                coords[i * d + k] = x;
+                lower[k] = std::min(lower[k], c);
+                upper[k] = std::max(upper[k], c);
+            }
+        }
+
+        // Cell indices are shifted by one, so adjacent cells of border points get valid keys.
+        vector<Key> strides(d);
+        double total = 1;
+        for (size_t k = 0; k < d; k++) {
+            strides[k] = (Key) total;
+            total *= upper[k] - lower[k] + 3;
+        }
+
+        if (total > 4611686018427387904.0) { // 2^62
+            return;
+        }
+
+        cells.resize(n);
+        order.resize(n);
+        for (int i = 0; i < n; i++) {
+            Key key = 0;
+            for (size_t k = 0; k < d; k++) {
+                double c = std::floor(coords[i * d + k] / width);
+                key += ((Key) (c - lower[k]) + 1) * strides[k];
+            }
+
+            cells[i] = key;
+            order[i] = i;
+        }
+
+        std::sort(order.begin(), order.end(), KeyLess(cells));
+        sorted.resize(n);
+        for (int i = 0; i < n; i++) {
+            sorted[i] = cells[order[i]];
+        }
+
+        adjacent.push_back(0);
+        for (size_t k = 0; k < d; k++) {
+            for (int j = 0, m = adjacent.size(); j < m; j++) {
+                adjacent.push_back(adjacent[j] - strides[k]);
+                adjacent.push_back(adjacent[j] + strides[k]);
+            }
+        }
+
+        keyed = true;
+    }
+
+    bool valid() const {
+        return keyed;
+    }
+
+    void query(int i, vector<int> &keys) const {
+        keys.clear();
+        const double *x = &coords[i * d];
+        for (int a = 0, m = adjacent.size(); a < m; a++) {
+            Key cell = cells[i] + adjacent[a];
+            vector<Key>::const_iterator first = std::lower_bound(sorted.begin(), sorted.end(), cell);
+            vector<Key>::const_iterator last = std::upper_bound(first, sorted.end(), cell);
+            for (int j = first - sorted.begin(), n = last - sorted.begin(); j < n; j++) {
+                int key = order[j];
+                const double *y = &coords[key * d];
+                double distance = 0;
+                for (size_t k = 0; k < d; k++) {
+                    double delta = x[k] - y[k];
+                    distance += delta * delta;
+                }
+
+                if (distance <= e2) {
+                    keys.push_back(key);
+                }
+            }
+        }
+
+        std::sort(keys.begin(), keys.end());
+    }
+
+    size_t memory() const {
+        return
+            coords.capacity() * sizeof(double) +
+            (cells.capacity() + sorted.capacity() + adjacent.capacity()) * sizeof(Key) +
+            order.capacity() * sizeof(int);
+    }
+};
+
+/*
+Neighborhood index backed by a k-d tree, used for points of more than three dimensions.
+*/
+class Tree: public Neighborhood {
+    KDTree tree;
+
+    double e2;
+
+public:
+    Tree(const List<Point> &points, double _e2):
+        tree(points),
+        e2(_e2)
+    {
+        // Nothing to do.
+    }
+
+    void query(int i, vector<int> &keys) const {
+        tree.radius2(tree.coordinates(i), e2, keys);
+        std::sort(keys.begin(), keys.end());
+    }
+
+    size_t memory() const {
+        return tree.memory();
+    }
+};
+
+static Neighborhood *neighborhood(const List<Point> &points, double e2) {
+    size_t d = 0;
     for (int i = 0, n = points.size(); i < n; i++) {
-        const Point &q = points[i];
-        double d = clarus::distance2(p, q);
-        if(d <= e2) {
-            keys.append(i);
+        d = std::max(d, points[i].dimension());
+    }
+
+    if (1 <= d && d <= 3 && e2 > 0) {
+        Grid *grid = new Grid(points, d, e2);
+        if (grid->valid()) {
+            return grid;
         }
+
+        delete grid;
     }
 
-    return keys;
+    return new Tree(points, e2);
 }
 
-Cloud dbscan::run(const clarus::List<Point> &points, float e, size_t b) {
-    Cloud cloud;
-    int n = points.size();
-    vector<bool> clustered(n, false);
-    vector<bool> visited(n, false);
+/* Minimum number of points per core detection task. */
+static const int CORE_BLOCK = 256;
 
-    for (int i = 0; i < n; i++) {
-        clustered.push_back(false);
-        visited.push_back(false);
+/*
+Flags the core points in the given range of blocks of block points each.
+*/
+static void detect_cores(
+    const Neighborhood &index,
+    size_t b,
+    int block,
+    vector<char> &core,
+    const cv::Range &blocks
+) {
+    int n = core.size();
+    vector<int> keys;
+    for (int i = blocks.start * block, m = std::min(blocks.end * block, n); i < m; i++) {
+        index.query(i, keys);
+        core[i] = (keys.size() >= b);
     }
+}
+
+dbscan::Usage::Usage():
+    index(0),
+    labels(0),
+    frontier(0)
+{
+    // Nothing to do.
+}
+
+size_t dbscan::Usage::total() const {
+    return index + labels + frontier;
+}
 
-    // for each unvisted point P in dataset keypoints
+dbscan::Labels::Labels():
+    clusters(0)
+{
+    // Nothing to do.
+}
+
+/*
+Assigns each point to a cluster (or NOISE) and returns the number of clusters. If order
+is not NULL, it receives the indices of clustered points in the order they were reached,
+so the points of each cluster are contiguous.
+
+Clusters are expanded breadth-first. A point enters the frontier only once across the
+whole run, when it is first reached by a core point, so the frontier never holds more
+than one cluster's worth of indices.
+*/
+static int expand(
+    const List<Point> &points,
+    float e,
+    size_t b,
+    vector<int> &labels,
+    vector<int> *order,
+    dbscan::Usage &usage
+) {
+    int n = points.size();
+    labels.assign(n, dbscan::NOISE);
+    if (n == 0) {
+        return 0;
+    }
+
+    // Index the points and find the core points (those with at least b neighbors) in parallel.
     double e2 = e * e;
+    boost::scoped_ptr<Neighborhood> index(neighborhood(points, e2));
+    vector<char> core(n, false);
+    int tasks = clarus::parallel::workers() * 4;
+    int block = std::max(CORE_BLOCK, (n + tasks - 1) / tasks);
+    int blocks = (n + block - 1) / block;
+    clarus::parallel::run(blocks, boost::bind(detect_cores, boost::cref(*index), b, block, boost::ref(core), _1));
+
+    int clusters = 0;
+    vector<bool> queued(n, false);
+    vector<int> frontier;
+    vector<int> keys;
     for (int i = 0; i < n; i++) {
-        if(visited[i]) {
+        if (queued[i] || !core[i]) {
             continue;
         }
 
-        const Point &p = points[i];
-        visited[i] = true; // mark point as visited
-        clarus::List<int> neighbors = query(points, p, e2);
-        if(neighbors.size() < b) {
-            // Point is noise, ignore it
-            continue;
-        }
+        int cluster = clusters++;
+        queued[i] = true;
+        frontier.assign(1, i);
+        for (size_t j = 0; j < frontier.size(); j++) {
+            int k = frontier[j];
+            labels[k] = cluster;
+            if (order != NULL) {
+                order->push_back(k);
+            }
 
-        //expand cluster
-        Cluster &c = cloud.append();
-        c.append(p); // add P to cluster c
-
-        //for each point P' in neighborPts
-        for (size_t j = 0; j < neighbors.size(); j++) {
-            //if P' is not visited
-            int k = neighbors[j];
-            const Point &q = points[k];
-            if (!visited[k]) {
-                //Mark P' as visited
-                visited[k] = true;
-                clarus::List<int> farther = query(points, q, e2);
-                if(farther.size() >= b) {
-                    neighbors.extend(farther);
-                }
+            // Border points join the cluster but do not expand it.
+            if (!core[k]) {
+                continue;
             }
 
-            // if q is not yet a member of any cluster
-            // add q to cluster c
-            if (!clustered[k]) {
-                clustered[k] = true;
-                c.append(q);
+            index->query(k, keys);
+            for (int l = 0, m = keys.size(); l < m; l++) {
+                int q = keys[l];
+                if (!queued[q]) {
+                    queued[q] = true;
+                    frontier.push_back(q);
+                }
             }
         }
     }
 
+    usage.index = index->memory();
+    usage.labels = labels.capacity() * sizeof(int) + core.capacity() + (queued.capacity() + 7) / 8;
+    usage.frontier = (frontier.capacity() + keys.capacity()) * sizeof(int);
+    return clusters;
+}
+
+dbscan::Labels dbscan::label(const List<Point> &points, float e, size_t b) {
+    Labels result;
+    result.clusters = expand(points, e, b, result.labels, NULL, result.usage);
+    return result;
+}
+
+Cloud dbscan::run(const List<Point> &points, float e, size_t b, Usage *usage) {
+    vector<int> labels;
+    vector<int> order;
+    order.reserve(points.size());
+
+    Usage used;
+    expand(points, e, b, labels, &order, used);
+    used.labels += order.capacity() * sizeof(int);
+    if (usage != NULL) {
+        *usage = used;
+    }
+
+    Cloud cloud;
+    for (int j = 0, n = order.size(); j < n; j++) {
+        int k = order[j];
+        if (labels[k] == (int) cloud.size()) {
+            cloud.append();
+        }
+
+        cloud[labels[k]].append(points[k]);
+    }
+
     return cloud;
 }
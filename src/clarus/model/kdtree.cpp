@@ -0,0 +1,317 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <clarus/model/kdtree.hpp>
+using clarus::KDTree;
+using clarus::List;
+using clarus::Point;
+
+#include <algorithm>
+#include <cmath>
+
+/*
+Compares point indices by their coordinates along a given axis.
+*/
+struct AxisLess {
+    const double *coords;
+
+    size_t d;
+
+    int axis;
+
+    AxisLess(const double *_coords, size_t _d, int _axis):
+        coords(_coords),
+        d(_d),
+        axis(_axis)
+    {
+        // Nothing to do.
+    }
+
+    bool operator () (int a, int b) const {
+        return coords[a * d + axis] < coords[b * d + axis];
+    }
+};
+
+KDTree::KDTree():
+    d(0)
+{
+    // Nothing to do.
+}
+
+KDTree::KDTree(const List<Point> &points, size_t leaf):
+    d(0)
+{
+    int n = points.size();
+    for (int i = 0; i < n; i++) {
+        d = std::max(d, points[i].dimension());
+    }
+
+    coords.resize(n * d, 0.0);
+    order.resize(n);
+    for (int i = 0; i < n; i++) {
+        const Point &p = points[i];
+        double *x = &coords[i * d];
+        for (int k = 0, m = p.dimension(); k < m; k++) {
+            x[k] = p[k];
+        }
+
+        order[i] = i;
+    }
+
+    if (n > 0) {
+        nodes.reserve(2 * n / std::max(leaf, (size_t) 1) + 1);
+        build(0, n, std::max(leaf, (size_t) 1));
+    }
+}
+
+int KDTree::build(int begin, int end, size_t leaf) {
+    int index = nodes.size();
+    nodes.push_back(Node());
+    Node &node = nodes.back();
+    node.begin = begin;
+    node.end = end;
+    node.axis = -1;
+    node.split = 0;
+    node.left = -1;
+    node.right = -1;
+
+    if ((size_t) (end - begin) <= leaf || d == 0) {
+        return index;
+    }
+
+    // Split along the axis of largest spread.
+    int axis = 0;
+    double spread = -1;
+    for (size_t k = 0; k < d; k++) {
+        double lower = coords[order[begin] * d + k];
+        double upper = lower;
+        for (int i = begin + 1; i < end; i++) {
+            double x = coords[order[i] * d + k];
+            lower = std::min(lower, x);
+            upper = std::max(upper, x);
+        }
+
+        if (upper - lower > spread) {
+            spread = upper - lower;
+            axis = k;
+        }
+    }
+
+    if (spread <= 0) {
+        return index;
+    }
+
+    int middle = (begin + end) / 2;
+    std::nth_element(
+        order.begin() + begin,
+        order.begin() + middle,
+        order.begin() + end,
+        AxisLess(&coords[0], d, axis)
+    );
+
+    double split = coords[order[middle] * d + axis];
+
+    // Children are built after the node is filled in, as they may reallocate the array.
+    int left = build(begin, middle, leaf);
+    int right = build(middle, end, leaf);
+
+    Node &parent = nodes[index];
+    parent.axis = axis;
+    parent.split = split;
+    parent.left = left;
+    parent.right = right;
+    return index;
+}
+
+double KDTree::project(const Point &p, std::vector<double> &x) const {
+    x.assign(d, 0.0);
+    for (size_t k = 0, m = std::min(p.dimension(), d); k < m; k++) {
+        x[k] = p[k];
+    }
+
+    // Coordinates beyond the tree's dimension add the same offset to all distances.
+    double extra = 0;
+    for (size_t k = d, m = p.dimension(); k < m; k++) {
+        extra += p[k] * p[k];
+    }
+
+    return extra;
+}
+
+List<int> KDTree::radius(const Point &p, double r) const {
+    std::vector<double> x;
+    double extra = project(p, x);
+
+    List<int> keys;
+    double r2 = r * r - extra;
+    if (r2 < 0) {
+        return keys;
+    }
+
+    radius2(d > 0 ? &x[0] : NULL, r2, *keys);
+    return keys;
+}
+
+void KDTree::radius2(const double *x, double r2, std::vector<int> &keys) const {
+    keys.clear();
+    if (nodes.empty()) {
+        return;
+    }
+
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+
+        if (node.axis < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                int key = order[i];
+                const double *y = &coords[key * d];
+                double distance = 0;
+                for (size_t k = 0; k < d; k++) {
+                    double delta = x[k] - y[k];
+                    distance += delta * delta;
+                }
+
+                if (distance <= r2) {
+                    keys.push_back(key);
+                }
+            }
+
+            continue;
+        }
+
+        double delta = x[node.axis] - node.split;
+        if (delta <= 0 || delta * delta <= r2) {
+            stack.push_back(node.left);
+        }
+
+        if (delta >= 0 || delta * delta <= r2) {
+            stack.push_back(node.right);
+        }
+    }
+}
+
+int KDTree::closest(const Point &p, double *distance, double epsilon) const {
+    std::vector<double> x;
+    double extra = project(p, x);
+
+    std::vector<std::pair<double, int> > best;
+    nearest2(d > 0 ? &x[0] : NULL, 1, epsilon, best);
+    if (best.empty()) {
+        return -1;
+    }
+
+    if (distance != NULL) {
+        *distance = std::sqrt(best[0].first + extra);
+    }
+
+    return best[0].second;
+}
+
+List<int> KDTree::nearest(const Point &p, int k, double epsilon) const {
+    std::vector<double> x;
+    project(p, x);
+
+    std::vector<std::pair<double, int> > best;
+    nearest2(d > 0 ? &x[0] : NULL, k, epsilon, best);
+
+    List<int> keys;
+    for (int i = 0, n = best.size(); i < n; i++) {
+        keys.append(best[i].second);
+    }
+
+    return keys;
+}
+
+void KDTree::nearest2(const double *x, int k, double epsilon, std::vector<std::pair<double, int> > &best) const {
+    typedef std::pair<double, int> Entry;
+
+    best.clear();
+    if (nodes.empty() || k <= 0) {
+        return;
+    }
+
+    // Nodes are pruned when even a point on their near boundary, brought (1 + epsilon)
+    // times closer, could not beat the current k-th best distance.
+    double scale = (1 + epsilon) * (1 + epsilon);
+
+    // Pending nodes, with lower bounds on the squared distance to their points.
+    std::vector<Entry> stack(1, Entry(0.0, 0));
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        if ((int) best.size() == k && entry.first * scale > best.front().first) {
+            continue;
+        }
+
+        const Node &node = nodes[entry.second];
+        if (node.axis < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                int key = order[i];
+                const double *y = &coords[key * d];
+                double distance = 0;
+                for (size_t j = 0; j < d; j++) {
+                    double delta = x[j] - y[j];
+                    distance += delta * delta;
+                }
+
+                if ((int) best.size() < k) {
+                    best.push_back(Entry(distance, key));
+                    std::push_heap(best.begin(), best.end());
+                }
+                else if (distance < best.front().first) {
+                    std::pop_heap(best.begin(), best.end());
+                    best.back() = Entry(distance, key);
+                    std::push_heap(best.begin(), best.end());
+                }
+            }
+
+            continue;
+        }
+
+        // Visit the near child first (it is pushed last), then the far one if still needed.
+        double delta = x[node.axis] - node.split;
+        int near = (delta <= 0 ? node.left : node.right);
+        int far = (delta <= 0 ? node.right : node.left);
+        stack.push_back(Entry(std::max(entry.first, delta * delta), far));
+        stack.push_back(Entry(entry.first, near));
+    }
+
+    std::sort_heap(best.begin(), best.end());
+}
+
+const double *KDTree::coordinates(int index) const {
+    return (d > 0 ? &coords[index * d] : NULL);
+}
+
+size_t KDTree::dimension() const {
+    return d;
+}
+
+size_t KDTree::memory() const {
+    return
+        coords.capacity() * sizeof(double) +
+        order.capacity() * sizeof(int) +
+        nodes.capacity() * sizeof(Node);
+}
+
+size_t KDTree::size() const {
+    return order.size();
+}
@@ -23,9 +23,25 @@ using clarus::Line2D;
 #include <clarus/model/point.hpp>
 using clarus::Point;
 
+#include <clarus/model/point_n.hpp>
+using clarus::PointN;
+
 #include <stdexcept>
 using std::runtime_error;
 
+Line2D::Points::Points(const List<Point> &points) {
+    int n = points.size();
+    reserve(n);
+    for (int i = 0; i < n; i++) {
+        const Point &point = points[i];
+        if (point.dimension() < 2) {
+            throw runtime_error("Point must have dimension >= 2");
+        }
+
+        append(PointN<2>(point));
+    }
+}
+
 Line2D::Line2D():
     a(NAN),
     b(NAN),
@@ -77,6 +93,27 @@ void Line2D::fit(const Point &p0, const Point &p1, double dx) {
     }
 }
 
+void Line2D::distances(const double *xs, const double *ys, size_t n, double *out) const {
+    if (isnan(a)) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = fabs(xs[i] - b);
+        }
+
+        return;
+    }
+
+    double norm = ::sqrt(::pow(a, 2.0) + 1);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = fabs(ys[i] - a * xs[i] - b) / norm;
+    }
+}
+
+void Line2D::distances(const Points &points, size_t begin, size_t end, double *out) const {
+    if (begin < end) {
+        distances(points.axis(0) + begin, points.axis(1) + begin, end - begin, out);
+    }
+}
+
 double Line2D::angle() const {
     return t;
 }
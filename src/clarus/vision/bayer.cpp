@@ -19,8 +19,17 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/vision/bayer.hpp>
 
+#include <clarus/core/parallel.hpp>
+using clarus::parallel::Band;
+
 #include <clarus/vision/images.hpp>
 
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include <cstdlib>
+#include <stdexcept>
+
 inline int channel(int i, int j) {
     return (
         i % 2 != j % 2 ? 1 : // Green
@@ -29,16 +38,32 @@ inline int channel(int i, int j) {
     );
 }
 
-cv::Mat bayer::filter(const cv::Mat &image) {
-    cv::Mat mosaic(image.size(), CV_8U, cv::Scalar(0));
-    for (int i = 0; i < mosaic.rows; i++) {
+/*
+Samples the mosaic over a band of rows. Channel selection only depends on the parity of
+row and column, so it is resolved once per row and the row is walked two pixels at a time.
+*/
+static void filter_band(const cv::Mat &image, cv::Mat &mosaic, const Band &band) {
+    for (int i = band.rows.start, n = mosaic.cols; i < band.rows.end; i++) {
+        int c0 = channel(i, 0);
+        int c1 = channel(i, 1) + 3;
         uchar *bayer = mosaic.ptr<uchar>(i);
-        const cv::Vec3b *bgr = image.ptr<cv::Vec3b>(i);
-        for (int j = 0; j < mosaic.cols; j++, bgr++, bayer++) {
-            *bayer = (*bgr)[channel(i, j)];
+        const uchar *bgr = image.ptr<uchar>(i);
+
+        int j = 0;
+        for (; j + 1 < n; j += 2, bgr += 6, bayer += 2) {
+            bayer[0] = bgr[c0];
+            bayer[1] = bgr[c1];
+        }
+
+        if (j < n) {
+            bayer[0] = bgr[c0];
         }
     }
+}
 
+cv::Mat bayer::filter(const cv::Mat &image) {
+    cv::Mat mosaic(image.size(), CV_8U);
+    clarus::parallel::bands(mosaic.rows, 0, boost::bind(filter_band, boost::cref(image), boost::ref(mosaic), _1));
     return mosaic;
 }
 
@@ -46,15 +71,236 @@ cv::Mat bayer::filter(const std::string &path) {
     return filter(images::load(path));
 }
 
-cv::Mat bayer::bgr(const cv::Mat &mosaic) {
-    cv::Mat image(mosaic.size(), CV_8UC3, cv::Scalar::all(0));
-    for (int i = 0; i < mosaic.rows; i++) {
+/*
+Scatters the mosaic samples over a band of rows. Every channel of every pixel is written,
+so the output doesn't need to be cleared beforehand.
+*/
+static void bgr_band(const cv::Mat &mosaic, cv::Mat &image, const Band &band) {
+    static const cv::Vec3b BLACK(0, 0, 0);
+
+    for (int i = band.rows.start, n = mosaic.cols; i < band.rows.end; i++) {
+        int c0 = channel(i, 0);
+        int c1 = channel(i, 1);
         const uchar *bayer = mosaic.ptr<uchar>(i);
         cv::Vec3b *bgr = image.ptr<cv::Vec3b>(i);
-        for (int j = 0; j < mosaic.cols; j++, bgr++, bayer++) {
-            (*bgr)[channel(i, j)] = *bayer;
+
+        int j = 0;
+        for (; j + 1 < n; j += 2, bgr += 2, bayer += 2) {
+            bgr[0] = BLACK;
+            bgr[0][c0] = bayer[0];
+            bgr[1] = BLACK;
+            bgr[1][c1] = bayer[1];
+        }
+
+        if (j < n) {
+            bgr[0] = BLACK;
+            bgr[0][c0] = bayer[0];
+        }
+    }
+}
+
+cv::Mat bayer::bgr(const cv::Mat &mosaic) {
+    cv::Mat image(mosaic.size(), CV_8UC3);
+    clarus::parallel::bands(mosaic.rows, 0, boost::bind(bgr_band, boost::cref(mosaic), boost::ref(image), _1));
+    return image;
+}
+
+/*
+Checks the given matrix is a valid mosaic, and returns a copy padded by the given
+number of pixels on each side. Mirrored borders keep the mosaic layout.
+*/
+static cv::Mat padded(const cv::Mat &mosaic, int border) {
+    if (mosaic.type() != CV_8U) {
+        throw std::runtime_error(
+            (boost::format("Mosaic must be of type CV_8U (%1%), got %2%") % CV_8U % mosaic.type()).str()
+        );
+    }
+
+    if (mosaic.rows <= border || mosaic.cols <= border) {
+        throw std::runtime_error(
+            (boost::format("Mosaic must be larger than %1% x %1% pixels") % border).str()
+        );
+    }
+
+    cv::Mat bordered;
+    cv::copyMakeBorder(mosaic, bordered, border, border, border, border, cv::BORDER_REFLECT_101);
+    return bordered;
+}
+
+/*
+Bilinear interpolation at a red or blue sample c, with the opposite color o.
+*/
+inline void bilinear_chroma(const uchar *u0, const uchar *u1, const uchar *u2, int j, int c, int o, uchar *bgr) {
+    bgr[c] = u1[j];
+    bgr[1] = (u1[j - 1] + u1[j + 1] + u0[j] + u2[j] + 2) >> 2;
+    bgr[o] = (u0[j - 1] + u0[j + 1] + u2[j - 1] + u2[j + 1] + 2) >> 2;
+}
+
+/*
+Bilinear interpolation at a green sample, with color h in the same row and color v in
+the same column.
+*/
+inline void bilinear_green(const uchar *u0, const uchar *u1, const uchar *u2, int j, int h, int v, uchar *bgr) {
+    bgr[1] = u1[j];
+    bgr[h] = (u1[j - 1] + u1[j + 1] + 1) >> 1;
+    bgr[v] = (u0[j] + u2[j] + 1) >> 1;
+}
+
+static void bilinear_band(const cv::Mat &bordered, cv::Mat &image, const Band &band) {
+    for (int i = band.rows.start, n = image.cols; i < band.rows.end; i++) {
+        const uchar *u0 = bordered.ptr<uchar>(i) + 1;
+        const uchar *u1 = bordered.ptr<uchar>(i + 1) + 1;
+        const uchar *u2 = bordered.ptr<uchar>(i + 2) + 1;
+        uchar *bgr = image.ptr<uchar>(i);
+
+        // Row parity is resolved once, then pixels are visited in pairs.
+        int j = 0;
+        if (i % 2 == 0) {
+            for (; j + 1 < n; j += 2, bgr += 6) {
+                bilinear_chroma(u0, u1, u2, j, 0, 2, bgr);
+                bilinear_green(u0, u1, u2, j + 1, 0, 2, bgr + 3);
+            }
+
+            if (j < n) {
+                bilinear_chroma(u0, u1, u2, j, 0, 2, bgr);
+            }
+        }
+        else {
+            for (; j + 1 < n; j += 2, bgr += 6) {
+                bilinear_green(u0, u1, u2, j, 2, 0, bgr);
+                bilinear_chroma(u0, u1, u2, j + 1, 2, 0, bgr + 3);
+            }
+
+            if (j < n) {
+                bilinear_green(u0, u1, u2, j, 2, 0, bgr);
+            }
+        }
+    }
+}
+
+cv::Mat bayer::bilinear(const cv::Mat &mosaic) {
+    cv::Mat bordered = padded(mosaic, 1);
+    cv::Mat image(mosaic.size(), CV_8UC3);
+    clarus::parallel::bands(mosaic.rows, 0, boost::bind(bilinear_band, boost::cref(bordered), boost::ref(image), _1));
+    return image;
+}
+
+/*
+Interpolates green at the red or blue sample in column j of the middle row u2, from the
+two rows above (u0, u1) and below (u3, u4).
+*/
+inline uchar interpolate_green(const uchar *u0, const uchar *u1, const uchar *u2, const uchar *u3, const uchar *u4, int j) {
+    int x = 2 * u2[j];
+    int lh = x - u2[j - 2] - u2[j + 2];
+    int lv = x - u0[j] - u4[j];
+    int dh = abs(u2[j - 1] - u2[j + 1]) + abs(lh);
+    int dv = abs(u1[j] - u3[j]) + abs(lv);
+
+    // Interpolations along each direction, scaled by 4.
+    int gh = 2 * (u2[j - 1] + u2[j + 1]) + lh;
+    int gv = 2 * (u1[j] + u3[j]) + lv;
+    int g = (dh < dv ? 2 * gh : dv < dh ? 2 * gv : gh + gv);
+    return cv::saturate_cast<uchar>((g + 4) >> 3);
+}
+
+static void green_band(const cv::Mat &bordered, cv::Mat &green, const Band &band) {
+    for (int i = band.rows.start, n = green.cols; i < band.rows.end; i++) {
+        const uchar *u0 = bordered.ptr<uchar>(i) + 2;
+        const uchar *u1 = bordered.ptr<uchar>(i + 1) + 2;
+        const uchar *u2 = bordered.ptr<uchar>(i + 2) + 2;
+        const uchar *u3 = bordered.ptr<uchar>(i + 3) + 2;
+        const uchar *u4 = bordered.ptr<uchar>(i + 4) + 2;
+        uchar *g = green.ptr<uchar>(i);
+
+        // Green samples are in odd columns of even rows, and even columns of odd rows.
+        int j = (i % 2 == 0 ? 0 : 1);
+        for (int k = 1 - j; k < n; k += 2) {
+            g[k] = u2[k];
+        }
+
+        for (; j < n; j += 2) {
+            g[j] = interpolate_green(u0, u1, u2, u3, u4, j);
+        }
+    }
+}
+
+/*
+Color-difference interpolation at a red or blue sample c, with the opposite color o.
+The m pointers are mosaic rows and the g pointers the matching green rows.
+*/
+inline void adaptive_chroma(
+    const uchar *m0, const uchar *m1, const uchar *m2,
+    const uchar *g0, const uchar *g1, const uchar *g2,
+    int j, int c, int o, uchar *bgr
+) {
+    int g = g1[j];
+    int d = (m0[j - 1] - g0[j - 1]) + (m0[j + 1] - g0[j + 1]) + (m2[j - 1] - g2[j - 1]) + (m2[j + 1] - g2[j + 1]);
+    bgr[c] = m1[j];
+    bgr[1] = g;
+    bgr[o] = cv::saturate_cast<uchar>(g + d / 4);
+}
+
+/*
+Color-difference interpolation at a green sample, with color h in the same row and
+color v in the same column.
+*/
+inline void adaptive_green(
+    const uchar *m0, const uchar *m1, const uchar *m2,
+    const uchar *g0, const uchar *g1, const uchar *g2,
+    int j, int h, int v, uchar *bgr
+) {
+    int g = g1[j];
+    int dh = (m1[j - 1] - g1[j - 1]) + (m1[j + 1] - g1[j + 1]);
+    int dv = (m0[j] - g0[j]) + (m2[j] - g2[j]);
+    bgr[1] = g;
+    bgr[h] = cv::saturate_cast<uchar>(g + dh / 2);
+    bgr[v] = cv::saturate_cast<uchar>(g + dv / 2);
+}
+
+static void adaptive_band(const cv::Mat &bordered, const cv::Mat &green, cv::Mat &image, const Band &band) {
+    for (int i = band.rows.start, n = image.cols; i < band.rows.end; i++) {
+        const uchar *m0 = bordered.ptr<uchar>(i + 1) + 2;
+        const uchar *m1 = bordered.ptr<uchar>(i + 2) + 2;
+        const uchar *m2 = bordered.ptr<uchar>(i + 3) + 2;
+        const uchar *g0 = green.ptr<uchar>(i) + 1;
+        const uchar *g1 = green.ptr<uchar>(i + 1) + 1;
+        const uchar *g2 = green.ptr<uchar>(i + 2) + 1;
+        uchar *bgr = image.ptr<uchar>(i);
+
+        int j = 0;
+        if (i % 2 == 0) {
+            for (; j + 1 < n; j += 2, bgr += 6) {
+                adaptive_chroma(m0, m1, m2, g0, g1, g2, j, 0, 2, bgr);
+                adaptive_green(m0, m1, m2, g0, g1, g2, j + 1, 0, 2, bgr + 3);
+            }
+
+            if (j < n) {
+                adaptive_chroma(m0, m1, m2, g0, g1, g2, j, 0, 2, bgr);
+            }
+        }
+        else {
+            for (; j + 1 < n; j += 2, bgr += 6) {
+                adaptive_green(m0, m1, m2, g0, g1, g2, j, 2, 0, bgr);
+                adaptive_chroma(m0, m1, m2, g0, g1, g2, j + 1, 2, 0, bgr + 3);
+            }
+
+            if (j < n) {
+                adaptive_green(m0, m1, m2, g0, g1, g2, j, 2, 0, bgr);
+            }
         }
     }
+}
+
+cv::Mat bayer::adaptive(const cv::Mat &mosaic) {
+    cv::Mat bordered = padded(mosaic, 2);
+
+    // First pass: full green plane, then mirrored by one pixel for the second pass.
+    cv::Mat green(mosaic.size(), CV_8U);
+    clarus::parallel::bands(mosaic.rows, 0, boost::bind(green_band, boost::cref(bordered), boost::ref(green), _1));
+    cv::copyMakeBorder(green, green, 1, 1, 1, 1, cv::BORDER_REFLECT_101);
 
+    // Second pass: red and blue from color differences.
+    cv::Mat image(mosaic.size(), CV_8UC3);
+    clarus::parallel::bands(mosaic.rows, 0, boost::bind(adaptive_band, boost::cref(bordered), boost::cref(green), boost::ref(image), _1));
     return image;
 }
@@ -22,12 +22,22 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #include <clarus/core/list.hpp>
 using clarus::List;
 
+#include <clarus/core/parallel.hpp>
+using clarus::parallel::Band;
+
 #include <clarus/vision/filters.hpp> // For CHANNEL_WISE macro
 
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
 List<cv::Mat> colors::BGRL(const cv::Mat &bgr) {
-    List<cv::Mat> bgrl = channels(bgr);
-    bgrl.append(lightness(bgr));
-    return bgrl;
+    List<Component> c;
+    c.append(BLUE);
+    c.append(GREEN);
+    c.append(RED);
+    c.append(LIGHTNESS);
+    return components(bgr, c);
 
 /*
     int rows = bgr.rows;
@@ -165,16 +175,167 @@ List<cv::Mat> colors::HLS(const cv::Mat &bgr) {
 }
 
 cv::Mat colors::hue(const cv::Mat &bgr) {
-    List<cv::Mat> hls = HLS(bgr);
-    return hls[0];
+    return component(bgr, HUE);
 }
 
 cv::Mat colors::lightness(const cv::Mat &bgr) {
-    List<cv::Mat> hls = HLS(bgr);
-    return hls[1];
+    return component(bgr, LIGHTNESS);
 }
 
 cv::Mat colors::saturation(const cv::Mat &bgr) {
-    List<cv::Mat> hls = HLS(bgr);
-    return hls[2];
+    return component(bgr, SATURATION);
+}
+
+cv::Mat colors::component(const cv::Mat &bgr, Component c) {
+    List<Component> requested;
+    requested.append(c);
+    return components(bgr, requested)[0];
+}
+
+/*
+Computes the requested components over a band of rows of an 8-bit BGR image.
+
+Hue and saturation follow the formulas used by cv::cvtColor(), with 8-bit hue scaled to
+the range [0, 180).
+*/
+static void components_band(
+    const cv::Mat &bgr,
+    const List<colors::Component> &requested,
+    List<cv::Mat> &outputs,
+    const Band &band
+) {
+    int n = requested.size();
+    int cols = bgr.cols;
+
+    // Per-pixel quantities are only computed if some requested component needs them.
+    bool extremes = false;
+    bool hue = false;
+    for (int k = 0; k < n; k++) {
+        colors::Component c = requested[k];
+        extremes = extremes || c > colors::RED;
+        hue = hue || c == colors::HUE;
+    }
+
+    std::vector<uchar*> rows(n);
+    for (int i = band.rows.start; i < band.rows.end; i++) {
+        const uchar *pixel = bgr.ptr<uchar>(i);
+        for (int k = 0; k < n; k++) {
+            rows[k] = outputs[k].ptr<uchar>(i);
+        }
+
+        for (int j = 0; j < cols; j++, pixel += 3) {
+            int b = pixel[0];
+            int g = pixel[1];
+            int r = pixel[2];
+
+            int v_max = 0;
+            int v_min = 0;
+            int diff = 0;
+            if (extremes) {
+                v_max = std::max(b, std::max(g, r));
+                v_min = std::min(b, std::min(g, r));
+                diff = v_max - v_min;
+            }
+
+            int h = 0;
+            if (hue && diff > 0) {
+                float d = 30.0f / diff;
+                float degrees = (
+                    v_max == r ? (g - b) * d :
+                    v_max == g ? (b - r) * d + 60.0f :
+                                 (r - g) * d + 120.0f
+                );
+
+                h = cvRound(degrees < 0 ? degrees + 180.0f : degrees);
+                h = (h < 180 ? h : 0);
+            }
+
+            for (int k = 0; k < n; k++) {
+                int value = 0;
+                switch (requested[k]) {
+                    case colors::BLUE:
+                        value = b;
+                        break;
+
+                    case colors::GREEN:
+                        value = g;
+                        break;
+
+                    case colors::RED:
+                        value = r;
+                        break;
+
+                    case colors::HUE:
+                        value = h;
+                        break;
+
+                    case colors::LIGHTNESS:
+                        value = (v_max + v_min + 1) >> 1;
+                        break;
+
+                    case colors::SATURATION:
+                        if (diff > 0) {
+                            int sum = v_max + v_min;
+                            value = cvRound(255.0f * diff / (sum < 255 ? sum : 510 - sum));
+                        }
+                        break;
+
+                    case colors::SATURATION_HSV:
+                        value = (v_max > 0 ? cvRound(255.0f * diff / v_max) : 0);
+                        break;
+
+                    case colors::VALUE:
+                        value = v_max;
+                        break;
+                }
+
+                rows[k][j] = (uchar) value;
+            }
+        }
+    }
+}
+
+List<cv::Mat> colors::components(const cv::Mat &bgr, const List<Component> &requested) {
+    List<cv::Mat> outputs;
+    int n = requested.size();
+
+    if (bgr.type() != CV_8UC3) {
+        // Fallback for other types: full conversions, computed at most once each.
+        List<cv::Mat> hls;
+        List<cv::Mat> hsv;
+        List<cv::Mat> planes;
+        for (int k = 0; k < n; k++) {
+            Component c = requested[k];
+            if (c <= RED) {
+                if (planes.empty()) {
+                    planes = channels(bgr);
+                }
+
+                outputs.append(planes[c - BLUE]);
+            }
+            else if (c <= SATURATION) {
+                if (hls.empty()) {
+                    hls = HLS(bgr);
+                }
+
+                outputs.append(hls[c - HUE]);
+            }
+            else {
+                if (hsv.empty()) {
+                    hsv = channels(bgr, CV_BGR2HSV);
+                }
+
+                outputs.append(hsv[c == VALUE ? 2 : 1]);
+            }
+        }
+
+        return outputs;
+    }
+
+    for (int k = 0; k < n; k++) {
+        outputs.append(cv::Mat(bgr.size(), CV_8U));
+    }
+
+    clarus::parallel::bands(bgr.rows, 0, boost::bind(components_band, boost::cref(bgr), boost::cref(requested), boost::ref(outputs), _1));
+    return outputs;
 }
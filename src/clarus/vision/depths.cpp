@@ -25,9 +25,18 @@ using clarus::List;
 #include <clarus/vision/colors.hpp>
 #include <clarus/vision/images.hpp>
 
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
+
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace depths
 {
 
@@ -35,9 +44,8 @@ typedef List<Depth> DepthRow;
 
 typedef List<DepthRow> DepthMap;
 
-cv::Mat load(const std::string &path) {
+static cv::Mat load_text(std::istream &file) {
     DepthMap values;
-    std::ifstream file(path.c_str());
     for (char c1 = '\0';;) {
         file >> c1;
         if (c1 == ']') {
@@ -69,15 +77,9 @@ cv::Mat load(const std::string &path) {
         }
     }
 
-
     return depths;
 }
 
-void save(const cv::Mat &depths, const std::string &path) {
-    std::ofstream file(path.c_str());
-    save(depths, file);
-}
-
 template <class T>
 static void save_(const cv::Mat &depths, std::ostream &out) {
     int rows = depths.rows;
@@ -106,14 +108,457 @@ static void save_(const cv::Mat &depths, std::ostream &out) {
     }
 }
 
-void save(const cv::Mat &depths, std::ostream &out)
+void save(const cv::Mat &depths, const std::string &path, Format format, double scale) {
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(str(boost::format("Could not open depth map file \"%s\"") % path));
+    }
+
+    save(depths, file, format, scale);
+}
+
+/*
+Header of binary depth frames. Fields are stored in host byte order.
+*/
+struct Header {
+    char magic[4];
+
+    boost::uint16_t version;
+
+    boost::uint16_t format;
+
+    boost::int32_t rows;
+
+    boost::int32_t cols;
+
+    boost::int32_t type;
+
+    boost::uint32_t reserved;
+
+    double scale;
+
+    /* Size of the frame data following the header, excluding padding. */
+    boost::uint64_t bytes;
+};
+
+static const char MAGIC[4] = {'C', 'D', 'E', 'P'};
+
+static const boost::uint16_t VERSION = 1;
+
+/* Frame data is padded to a multiple of this many bytes, keeping headers and data aligned. */
+static const size_t ALIGNMENT = 8;
+
+static size_t padded(size_t bytes) {
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static bool is_binary(const char *magic) {
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+static size_t raw_size(const Header &header) {
+    return (size_t) header.rows * header.cols * CV_ELEM_SIZE(header.type);
+}
+
+static void validate(const Header &header) {
+    if (!is_binary(header.magic)) {
+        throw std::runtime_error("Invalid depth frame header");
+    }
+
+    if (header.version != VERSION) {
+        throw std::runtime_error(str(boost::format("Unsupported depth frame version %d") % header.version));
+    }
+
+    if (header.format != BINARY && header.format != COMPRESSED) {
+        throw std::runtime_error(str(boost::format("Invalid depth frame format %d") % header.format));
+    }
+
+    if (header.type != CV_16U && header.type != CV_32F && header.type != CV_64F) {
+        throw std::runtime_error(str(boost::format("Invalid depth frame type %d") % header.type));
+    }
+
+    if (header.rows <= 0 || header.cols <= 0) {
+        throw std::runtime_error(str(boost::format("Invalid depth frame size %dx%d") % header.cols % header.rows));
+    }
+
+    if (header.format == BINARY ? header.bytes != raw_size(header) : header.bytes == 0) {
+        throw std::runtime_error("Depth frame data size does not match its header");
+    }
+}
+
+/*
+Encodes a byte sequence with the PackBits run-length scheme: a control byte c < 128 is
+followed by c + 1 literal bytes, and a control byte c > 128 by a single byte to be
+repeated 257 - c times.
+*/
+static void pack(const std::vector<uchar> &in, std::vector<uchar> &out) {
+    size_t n = in.size();
+    for (size_t i = 0; i < n;) {
+        size_t run = 1;
+        while (i + run < n && run < 128 && in[i + run] == in[i]) {
+            run++;
+        }
+
+        if (run >= 3) {
+            out.push_back((uchar) (257 - run));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < n && i - start < 128) {
+            if (i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2]) {
+                break;
+            }
+
+            i++;
+        }
+
+        out.push_back((uchar) (i - start - 1));
+        out.insert(out.end(), in.begin() + start, in.begin() + i);
+    }
+}
+
+static void unpack(const uchar *in, size_t size, uchar *out, size_t length) {
+    const uchar *end = in + size;
+    uchar *last = out + length;
+    while (in < end) {
+        int c = *in++;
+        if (c < 128) {
+            size_t k = c + 1;
+            if ((size_t) (end - in) < k || (size_t) (last - out) < k) {
+                throw std::runtime_error("Corrupt compressed depth frame");
+            }
+
+            std::memcpy(out, in, k);
+            out += k;
+            in += k;
+        }
+        else if (c > 128) {
+            size_t k = 257 - c;
+            if (in == end || (size_t) (last - out) < k) {
+                throw std::runtime_error("Corrupt compressed depth frame");
+            }
+
+            std::memset(out, *in++, k);
+            out += k;
+        }
+    }
+
+    if (out != last) {
+        throw std::runtime_error("Corrupt compressed depth frame");
+    }
+}
+
+/*
+Predicts each value from its left neighbor (or the one above, at the start of a row),
+splits the prediction residuals into byte planes and run-length encodes the result.
+Residuals are computed on the values' bit patterns with wrap-around arithmetic, so the
+round trip is exact for any value, including NaN's and infinities.
+*/
+template<class U>
+static void encode_(const cv::Mat &depths, std::vector<uchar> &out) {
+    int rows = depths.rows;
+    int cols = depths.cols;
+    size_t n = (size_t) rows * cols;
+
+    std::vector<uchar> planes(n * sizeof(U));
+    for (int i = 0, k = 0; i < rows; i++) {
+        const U *row = depths.ptr<U>(i);
+        const U *above = (i > 0 ? depths.ptr<U>(i - 1) : NULL);
+        for (int j = 0; j < cols; j++, k++) {
+            U predicted = (j > 0 ? row[j - 1] : above != NULL ? above[0] : 0);
+            U residual = (U) (row[j] - predicted);
+            for (size_t b = 0; b < sizeof(U); b++) {
+                planes[b * n + k] = (uchar) (residual >> (8 * b));
+            }
+        }
+    }
+
+    pack(planes, out);
+}
+
+template<class U>
+static void decode_(const uchar *in, size_t size, cv::Mat &depths) {
+    int rows = depths.rows;
+    int cols = depths.cols;
+    size_t n = (size_t) rows * cols;
+
+    std::vector<uchar> planes(n * sizeof(U));
+    unpack(in, size, &planes[0], planes.size());
+    for (int i = 0, k = 0; i < rows; i++) {
+        U *row = depths.ptr<U>(i);
+        const U *above = (i > 0 ? depths.ptr<U>(i - 1) : NULL);
+        for (int j = 0; j < cols; j++, k++) {
+            U residual = 0;
+            for (size_t b = 0; b < sizeof(U); b++) {
+                residual |= ((U) planes[b * n + k]) << (8 * b);
+            }
+
+            U predicted = (j > 0 ? row[j - 1] : above != NULL ? above[0] : 0);
+            row[j] = (U) (predicted + residual);
+        }
+    }
+}
+
+static void encode(const cv::Mat &depths, std::vector<uchar> &out) {
+    switch (depths.type()) {
+        case CV_16U: encode_<boost::uint16_t>(depths, out); break;
+        case CV_32F: encode_<boost::uint32_t>(depths, out); break;
+        case CV_64F: encode_<boost::uint64_t>(depths, out); break;
+    }
+}
+
+static void decode(const uchar *in, size_t size, cv::Mat &depths) {
+    switch (depths.type()) {
+        case CV_16U: decode_<boost::uint16_t>(in, size, depths); break;
+        case CV_32F: decode_<boost::uint32_t>(in, size, depths); break;
+        case CV_64F: decode_<boost::uint64_t>(in, size, depths); break;
+    }
+}
+
+static void save_binary(const cv::Mat &depths, std::ostream &out, Format format, double scale) {
+    int type = depths.type();
+    if (type != CV_16U && type != CV_32F && type != CV_64F) {
+        throw std::runtime_error("Binary depth map type must be CV_16U, CV_32F or CV_64F");
+    }
+
+    if (depths.empty()) {
+        throw std::runtime_error("Cannot save an empty depth map");
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.format = format;
+    header.rows = depths.rows;
+    header.cols = depths.cols;
+    header.type = type;
+    header.reserved = 0;
+    header.scale = scale;
+
+    std::vector<uchar> buffer;
+    if (format == COMPRESSED) {
+        encode(depths, buffer);
+        header.bytes = buffer.size();
+    }
+    else {
+        header.bytes = raw_size(header);
+    }
+
+    out.write((const char*) &header, sizeof(Header));
+    if (format == COMPRESSED) {
+        out.write((const char*) &buffer[0], buffer.size());
+    }
+    else if (depths.isContinuous()) {
+        out.write((const char*) depths.data, header.bytes);
+    }
+    else {
+        size_t width = depths.cols * depths.elemSize();
+        for (int i = 0; i < depths.rows; i++) {
+            out.write((const char*) depths.ptr(i), width);
+        }
+    }
+
+    static const char PADDING[ALIGNMENT] = {0};
+    out.write(PADDING, padded(header.bytes) - header.bytes);
+    if (!out) {
+        throw std::runtime_error("Error writing depth map");
+    }
+}
+
+/*
+Reads the next binary frame from the given stream into the given matrix. Returns false
+if the stream is at its end.
+*/
+static bool load_binary(std::istream &in, cv::Mat &depths, double &scale, std::vector<uchar> &buffer) {
+    Header header;
+    in.read((char*) &header, sizeof(Header));
+    if (in.gcount() == 0) {
+        return false;
+    }
+
+    if (in.gcount() != sizeof(Header)) {
+        throw std::runtime_error("Truncated depth frame header");
+    }
+
+    validate(header);
+    depths.create(header.rows, header.cols, header.type);
+    if (header.format == BINARY) {
+        in.read((char*) depths.data, header.bytes);
+    }
+    else {
+        buffer.resize(header.bytes);
+        in.read((char*) &buffer[0], header.bytes);
+    }
+
+    if (in.gcount() != (std::streamsize) header.bytes) {
+        throw std::runtime_error("Truncated depth frame data");
+    }
+
+    if (header.format == COMPRESSED) {
+        decode(&buffer[0], header.bytes, depths);
+    }
+
+    in.ignore(padded(header.bytes) - header.bytes);
+    scale = header.scale;
+    return true;
+}
+
+cv::Mat load(const std::string &path, double *scale) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(str(boost::format("Could not open depth map file \"%s\"") % path));
+    }
+
+    char magic[sizeof(MAGIC)] = {0};
+    file.read(magic, sizeof(MAGIC));
+    file.clear();
+    file.seekg(0);
+
+    if (!is_binary(magic)) {
+        if (scale != NULL) {
+            *scale = 1.0;
+        }
+
+        return load_text(file);
+    }
+
+    cv::Mat depths;
+    double factor = 1.0;
+    std::vector<uchar> buffer;
+    load_binary(file, depths, factor, buffer);
+    if (scale != NULL) {
+        *scale = factor;
+    }
+
+    return depths;
+}
+
+void save(const cv::Mat &depths, std::ostream &out, Format format, double scale) {
+    if (format != TEXT) {
+        save_binary(depths, out, format, scale);
+        return;
+    }
+
+    switch (depths.type()) {
+        case CV_32F: save_<float>(depths, out);  break;
+        case CV_64F: save_<double>(depths, out); break;
+        default: throw std::runtime_error("Depth map type must be either CV_32F or CV_64F");
+    }
+}
+
+struct Mapping::Region {
+    void *data;
+
+    size_t size;
+
+    Region(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(str(boost::format("Could not open depth map file \"%s\"") % path));
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error(str(boost::format("Could not map depth map file \"%s\"") % path));
+        }
+
+        size = info.st_size;
+        data = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            throw std::runtime_error(str(boost::format("Could not map depth map file \"%s\"") % path));
+        }
+    }
+
+    ~Region() {
+        ::munmap(data, size);
+    }
+};
+
+Mapping::Mapping(const std::string &path):
+    region(new Region(path))
 {
-  switch (depths.type())
-  {
-    case CV_32F: save_<float>(depths, out);  break;
-    case CV_64F: save_<double>(depths, out); break;
-    default: throw std::runtime_error("Depth map type must be either CV_32F or CV_64F");
-  }
+    const uchar *data = (const uchar*) region->data;
+    size_t size = region->size;
+    for (size_t offset = 0; offset < size;) {
+        if (size - offset < sizeof(Header)) {
+            throw std::runtime_error(str(boost::format("Truncated depth frame header in \"%s\"") % path));
+        }
+
+        Header header;
+        std::memcpy(&header, data + offset, sizeof(Header));
+        validate(header);
+        if (header.bytes > size - offset - sizeof(Header)) {
+            throw std::runtime_error(str(boost::format("Truncated depth frame data in \"%s\"") % path));
+        }
+
+        offsets.push_back(offset);
+        offset += sizeof(Header) + padded(header.bytes);
+    }
+}
+
+cv::Mat Mapping::operator [] (int index) const {
+    uchar *frame = (uchar*) region->data + offsets.at(index);
+    Header header;
+    std::memcpy(&header, frame, sizeof(Header));
+
+    uchar *data = frame + sizeof(Header);
+    if (header.format == BINARY) {
+        return cv::Mat(header.rows, header.cols, header.type, data);
+    }
+
+    cv::Mat depths(header.rows, header.cols, header.type);
+    decode(data, header.bytes, depths);
+    return depths;
+}
+
+double Mapping::scale(int index) const {
+    Header header;
+    std::memcpy(&header, (uchar*) region->data + offsets.at(index), sizeof(Header));
+    return header.scale;
+}
+
+int Mapping::size() const {
+    return offsets.size();
+}
+
+Reader::Reader(const std::string &path):
+    file(path.c_str(), std::ios::in | std::ios::binary),
+    lastScale(1.0)
+{
+    if (!file) {
+        throw std::runtime_error(str(boost::format("Could not open depth map file \"%s\"") % path));
+    }
+}
+
+bool Reader::next(cv::Mat &depths) {
+    return load_binary(file, depths, lastScale, buffer);
+}
+
+double Reader::scale() const {
+    return lastScale;
+}
+
+Writer::Writer(const std::string &path, Format _format):
+    file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc),
+    format(_format)
+{
+    if (format == TEXT) {
+        throw std::runtime_error("Depth map sequences must be written in a binary format");
+    }
+
+    if (!file) {
+        throw std::runtime_error(str(boost::format("Could not open depth map file \"%s\"") % path));
+    }
+}
+
+void Writer::write(const cv::Mat &depths, double scale) {
+    save_binary(depths, file, format, scale);
 }
 
 cv::Mat bgr(const cv::Mat &depths) {
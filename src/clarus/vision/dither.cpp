@@ -19,92 +19,203 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/vision/dither.hpp>
 
+#include <clarus/core/parallel.hpp>
 #include <clarus/vision/filters.hpp>
 
-cv::Mat dither::binary(const cv::Mat &image, double threshold) {
-    CHANNEL_WISE(binary, image, threshold);
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <stdexcept>
 
+cv::Mat dither::binary(const cv::Mat &image, double threshold) {
+    // cv::threshold() works element-wise, so multi-channel images are processed in a
+    // single vectorized pass instead of being split.
     cv::Mat dithered;
     cv::threshold(image, dithered, threshold, 255, cv::THRESH_BINARY);
     return dithered;
 }
 
 /*
-Calculates a table of 256 assignments with as many distinct values as the given bit depth.
+Tables of 256 assignments with as many distinct values as each bit depth from 1 to 8.
 
 Values are taken at equal intervals from the ranges [0, 128) and [128, 256),
 such that both 0 and 255 are always included in the range.
+
+Tables are computed once at startup and never modified, so they are safe to read
+concurrently.
 */
-static cv::Mat lookup(uchar bits) {
-    static std::map<uchar, cv::Mat> tables;
-    if (tables.count(bits) > 0) {
-        return tables[bits];
-    }
+static struct Tables {
+    uchar values[9][256];
+
+    Tables() {
+        for (int bits = 1; bits <= 8; bits++) {
+            int factor = 256 >> bits;
+            uchar *p = values[bits];
 
-    int factor = 256 / pow(2, bits);
-    cv::Mat table(1, 256, CV_8U);
-    uchar *p = table.data;
+            for(int i = 0; i < 128; ++i) {
+                p[i] = factor * (i / factor);
+            }
 
-    for(int i = 0; i < 128; ++i) {
-        p[i] = factor * (i / factor);
+            for(int i = 128; i < 256; ++i) {
+                p[i] = factor * (1 + (i / factor)) - 1;
+            }
+        }
     }
+} TABLES;
 
-    for(int i = 128; i < 256; ++i) {
-        p[i] = factor * (1 + (i / factor)) - 1;
+static const uchar *lookup(uchar bits) {
+    if (bits > 8) {
+        throw std::runtime_error((boost::format("Bit depth must be in the range [0, 8], got %1%") % ((int) bits)).str());
     }
 
-    tables[bits] = table;
-    return table;
+    // A depth of 0 yields the same binary table as a depth of 1.
+    return TABLES.values[std::max<int>(bits, 1)];
 }
 
 cv::Mat dither::threshold(const cv::Mat &image, uchar bits) {
-    CHANNEL_WISE(threshold, image, bits);
-
-    cv::Mat table = lookup(bits);
+    // As with binary(), cv::LUT() handles multi-channel images in a single pass.
+    cv::Mat table(1, 256, CV_8U, (void*) lookup(bits));
     cv::Mat dithered;
     cv::LUT(image, table, dithered);
     return dithered;
 }
 
-inline void update(uchar &pixel, double u) {
-    pixel = (uchar) (u > 0 ? std::min(255.0, u + pixel) : std::max(0.0, u + pixel));
-}
+/* Number of columns processed between progress updates in wavefront diffusion. */
+static const int DIFFUSION_BLOCK = 32;
 
-inline uchar& neighbor(uchar *cell, int cols, int i, int j) {
-    return *(cell + i * cols + j);
-}
+/* Minimum number of rows per thread in wavefront diffusion. */
+static const int DIFFUSION_MIN_ROWS = 16;
 
-cv::Mat dither::diffusion(const cv::Mat &image, uchar bits) {
-    static const double quant_1_2 = 7.0 / 16.0;
-    static const double quant_2_0 = 3.0 / 16.0;
-    static const double quant_2_1 = 5.0 / 16.0;
-    static const double quant_2_2 = 1.0 / 16.0;
+/*
+Shared state of a wavefront diffusion run.
 
-    CHANNEL_WISE(diffusion, image, bits);
+Errors are kept as integers scaled by 16, so the Floyd-Steinberg weights (7, 3, 5 and 1
+sixteenths) are exact. Each row reads the errors diffused by the row above from one
+buffer row and writes the errors it diffuses to the row below into the next, so with T
+rows in flight only T + 1 buffer rows are needed. Buffer rows have one extra cell on
+each side, so border pixels need no special cases.
+*/
+struct Diffusion {
+    const cv::Mat &image;
 
-    int rows = image.rows;
-    int cols = image.cols;
+    cv::Mat &dithered;
 
-    cv::Mat dithered;
-    cv::copyMakeBorder(image, dithered, 0, rows + 1, 0, cols + 1, cv::BORDER_CONSTANT, cv::Scalar(0));
+    const uchar *table;
+
+    /* Number of rows processed concurrently. */
+    int threads;
+
+    /* Ring of error buffer rows, of type CV_32S. */
+    cv::Mat errors;
 
-    cv::Mat table = lookup(bits);
+    /* Number of pixels completed in each row. */
+    boost::scoped_array<boost::atomic<int> > progress;
 
-    for (int i = 0; i < rows; i++) {
-        uchar *cell = dithered.ptr<uchar>(i);
-        for (int j = 0; j < cols; j++, cell++) {
-            double pix = *cell;
-            double dit = table.at<uchar>(pix);
-            double err = pix - dit;
+    Diffusion(const cv::Mat &_image, cv::Mat &_dithered, const uchar *_table, int _threads):
+        image(_image),
+        dithered(_dithered),
+        table(_table),
+        threads(_threads),
+        errors(cv::Mat::zeros(_threads + 1, (_image.cols + 2) * _image.channels(), CV_32S)),
+        progress(new boost::atomic<int>[_image.rows])
+    {
+        for (int i = 0, n = image.rows; i < n; i++) {
+            progress[i].store(0);
+        }
+    }
 
-            *cell = (uchar) dit;
+    /*
+    Dithers row i, waiting as needed for the row above to move at least two pixels ahead.
+    */
+    void row(int i) {
+        int k = i % (threads + 1);
+        int l = (i + 1) % (threads + 1);
+        int cols = image.cols;
+        int cn = image.channels();
+        const uchar *u = image.ptr<uchar>(i);
+        uchar *v = dithered.ptr<uchar>(i);
+        const int *above = errors.ptr<int>(k) + cn;
+        int *below = errors.ptr<int>(l) + cn;
+        boost::atomic<int> *waiting = (i > 0 && threads > 1 ? &progress[i - 1] : NULL);
+        boost::atomic<int> &done = progress[i];
+
+        // Errors carried to the right and bottom-right neighbors, per channel.
+        int carries[8] = {0};
+        int *right = carries;
+        int *diagonal = carries + 4;
+        std::fill(below - cn, below, 0);
+
+        for (int j_0 = 0; j_0 < cols; j_0 += DIFFUSION_BLOCK) {
+            int j_n = std::min(j_0 + DIFFUSION_BLOCK, cols);
+            if (waiting != NULL) {
+                int needed = std::min(j_n + 1, cols);
+                while (waiting->load(boost::memory_order_acquire) < needed) {
+                    boost::this_thread::yield();
+                }
+            }
+
+            for (int j = j_0; j < j_n; j++) {
+                for (int c = 0, n = j * cn; c < cn; c++, n++) {
+                    int error = above[n] + right[c];
+                    int value = std::max(0, std::min(255, u[n] + ((error + 8) >> 4)));
+                    int quantized = table[value];
+                    int e = value - quantized;
+                    v[n] = quantized;
+
+                    below[n - cn] += 3 * e;
+                    below[n] = 5 * e + diagonal[c];
+                    diagonal[c] = e;
+                    right[c] = 7 * e;
+                }
+            }
+
+            done.store(j_n, boost::memory_order_release);
+        }
+    }
 
-            update(neighbor(cell, cols, i + 0, j + 1), err * quant_1_2);
-            update(neighbor(cell, cols, i + 1, j - 1), err * quant_2_0);
-            update(neighbor(cell, cols, i + 1, j + 0), err * quant_2_1);
-            update(neighbor(cell, cols, i + 1, j + 1), err * quant_2_2);
+    /*
+    Dithers rows t, t + threads, t + 2 * threads...
+    */
+    void run(int t) {
+        for (int i = t, rows = image.rows; i < rows; i += threads) {
+            row(i);
         }
     }
+};
+
+cv::Mat dither::diffusion(const cv::Mat &image, uchar bits) {
+    if (image.channels() > 4) {
+        return filter::channelwise(boost::bind(diffusion, _1, bits), image);
+    }
+
+    cv::Mat pixels;
+    if (image.depth() != CV_8U) {
+        image.convertTo(pixels, CV_8U);
+    }
+    else {
+        pixels = image;
+    }
+
+    const uchar *table = lookup(bits);
+    cv::Mat dithered(pixels.size(), pixels.type());
+
+    // Rows are dithered in a wavefront: each thread takes every T-th row, and only
+    // starts on a block of pixels once the row above is two pixels past it, which is
+    // when all errors diffused into that block are final.
+    int rows = pixels.rows;
+    int threads = std::max(1, std::min(clarus::parallel::workers(), rows / DIFFUSION_MIN_ROWS));
+    Diffusion diffusion(pixels, dithered, table, threads);
+
+    boost::thread_group workers;
+    for (int t = 1; t < threads; t++) {
+        workers.create_thread(boost::bind(&Diffusion::run, &diffusion, t));
+    }
 
-    return dithered(cv::Rect(0, 0, cols, rows));
+    diffusion.run(0);
+    workers.join_all();
+
+    return dithered;
 }
@@ -25,6 +25,9 @@ using clarus::ListIterator;
 using clarus::ListIteratorConst;
 
 #include <clarus/core/math.hpp>
+#include <clarus/core/parallel.hpp>
+using clarus::parallel::Band;
+
 #include <clarus/core/types.hpp>
 
 #include <clarus/model/point.hpp>
@@ -36,17 +39,37 @@ using clarus::distance2;
 #include <clarus/vision/cvmat.hpp>
 #include <clarus/vision/gaussian.hpp>
 #include <clarus/vision/images.hpp>
+#include <clarus/vision/pipeline.hpp>
 
-cv::Mat filter::channelwise(Filter f, const cv::Mat &image) {
-    List<cv::Mat> channels;
-    cv::split(image, *channels);
-    for (ListIterator<cv::Mat> i(channels); i.more();) {
-        cv::Mat &channel = i.next();
-        channel = f(channel);
+#include <boost/format.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+/*
+Extracts each channel in the given range and applies the filter to it. Each task writes
+only to its own output slot, so tasks can run concurrently.
+*/
+static void channelwise_task(
+    const filter::Filter &f,
+    const cv::Mat &image,
+    std::vector<cv::Mat> &outputs,
+    const cv::Range &range
+) {
+    for (int k = range.start; k < range.end; k++) {
+        cv::Mat channel;
+        cv::extractChannel(image, channel, k);
+        outputs[k] = f(channel);
     }
+}
+
+cv::Mat filter::channelwise(Filter f, const cv::Mat &image) {
+    int n = image.channels();
+    std::vector<cv::Mat> outputs(n);
+    clarus::parallel::run(n, boost::bind(channelwise_task, boost::cref(f), boost::cref(image), boost::ref(outputs), _1));
 
     cv::Mat result;
-    cv::merge(*channels, result);
+    cv::merge(outputs, result);
     return result;
 }
 
@@ -114,153 +137,265 @@ cv::Mat filter::gamma(const cv::Mat &src, double g) {
     return dst;
 }
 
-cv::Mat filter::gradients(const cv::Mat &l) {
-    // Gradient across X axis
-    cv::Mat grad_x;
-    cv::Sobel(l, grad_x, CV_16S, 1, 0, 3);
+/*
+Computes the gradient magnitude (and optionally orientation) over a band of rows.
+*/
+template<class T, class O> static void gradient_band(
+    const cv::Mat &image,
+    cv::Mat &magnitude,
+    cv::Mat *orientation,
+    const Band &band
+) {
+    static const double TWO_PI = 2.0 * M_PI;
+
+    int rows = image.rows;
+    int cols = image.cols;
+    int cn = image.channels();
+    for (int i = band.rows.start; i < band.rows.end; i++) {
+        const T *u0 = image.ptr<T>(kernel_reflect(i - 1, rows));
+        const T *u1 = image.ptr<T>(i);
+        const T *u2 = image.ptr<T>(kernel_reflect(i + 1, rows));
+        O *v = magnitude.ptr<O>(i);
+        float *o = (orientation != NULL ? orientation->ptr<float>(i) : NULL);
+
+        for (int j = 0; j < cols; j++) {
+            int a = (j > 0 ? j - 1 : kernel_reflect(-1, cols)) * cn;
+            int b = (j + 1 < cols ? j + 1 : kernel_reflect(cols, cols)) * cn;
+            int m = j * cn;
+
+            double total = 0.0;
+            double largest = -1.0;
+            double dx_l = 0.0;
+            double dy_l = 0.0;
+            for (int c = 0; c < cn; c++, a++, b++, m++) {
+                double dx = (u0[b] + 2.0 * u1[b] + u2[b]) - (u0[a] + 2.0 * u1[a] + u2[a]);
+                double dy = (u2[a] + 2.0 * u2[m] + u2[b]) - (u0[a] + 2.0 * u0[m] + u0[b]);
+                double g = sqrt(dx * dx + dy * dy);
+                total += g;
+
+                if (g > largest) {
+                    largest = g;
+                    dx_l = dx;
+                    dy_l = dy;
+                }
+            }
+
+            v[j] = cv::saturate_cast<O>(total);
+
+            if (o != NULL) {
+                double angle = atan2(dy_l, dx_l);
+                o[j] = (float) (angle < 0.0 ? angle + TWO_PI : angle);
+            }
+        }
+    }
+}
 
-    // Gradient across Y axis
-    cv::Mat grad_y;
-    cv::Sobel(l, grad_y, CV_16S, 0, 1, 3);
+template<class T> static void gradient_dispatch(const cv::Mat &image, cv::Mat &magnitude, cv::Mat *orientation) {
+    int rows = image.rows;
+    switch (magnitude.depth()) {
+        case CV_8U:
+            clarus::parallel::bands(rows, 1, boost::bind(gradient_band<T, uchar>, boost::cref(image), boost::ref(magnitude), orientation, _1));
+            break;
 
-    // Gradient magnitude
-    cv::Mat grad_xy = clarus::pow(clarus::pow(grad_x, 2.0) + clarus::pow(grad_y, 2.0), 0.5);
+        case CV_16U:
+            clarus::parallel::bands(rows, 1, boost::bind(gradient_band<T, ushort>, boost::cref(image), boost::ref(magnitude), orientation, _1));
+            break;
 
-    return images::convert(grad_xy, CV_8U);
+        case CV_32F:
+            clarus::parallel::bands(rows, 1, boost::bind(gradient_band<T, float>, boost::cref(image), boost::ref(magnitude), orientation, _1));
+            break;
+
+        case CV_64F:
+            clarus::parallel::bands(rows, 1, boost::bind(gradient_band<T, double>, boost::cref(image), boost::ref(magnitude), orientation, _1));
+            break;
+    }
 }
 
+cv::Mat filter::gradient(const cv::Mat &image, int type, cv::Mat *orientation) {
+    if (type != CV_8U && type != CV_16U && type != CV_32F && type != CV_64F) {
+        throw std::runtime_error((boost::format("Unsupported gradient output type %1%") % type).str());
+    }
+
+    cv::Mat magnitude(image.size(), type);
+    if (orientation != NULL) {
+        orientation->create(image.size(), CV_32F);
+    }
+
+    switch (image.depth()) {
+        case CV_8U:  gradient_dispatch<uchar>(image, magnitude, orientation);  break;
+        case CV_16U: gradient_dispatch<ushort>(image, magnitude, orientation); break;
+        case CV_16S: gradient_dispatch<short>(image, magnitude, orientation);  break;
+        case CV_32F: gradient_dispatch<float>(image, magnitude, orientation);  break;
+        case CV_64F: gradient_dispatch<double>(image, magnitude, orientation); break;
+        default: {
+            cv::Mat converted;
+            image.convertTo(converted, CV_64F);
+            gradient_dispatch<double>(converted, magnitude, orientation);
+        }
+    }
+
+    return magnitude;
+}
+
+cv::Mat filter::gradients(const cv::Mat &l) {
+    CHANNEL_WISE(gradients, l);
+
+    return gradient(l, CV_8U);
+}
+
+/*
+Laws' texture energy masks, in the order of the mask indices used by filter::laws().
+*/
+static const double LAWS_E5E5[] = {
+    1.0,  2.0,  0.0, -2.0, -1.0,
+    2.0,  4.0,  0.0, -4.0, -2.0,
+    0.0,  0.0,  0.0,  0.0,  0.0,
+   -2.0, -4.0,  0.0,  4.0,  2.0,
+   -1.0, -2.0,  0.0,  2.0,  1.0
+};
+
+static const double LAWS_E5R5[] = {
+    -1.0,   4.0,  -6.0,   4.0,  -1.0,
+    -2.0,   8.0, -12.0,   8.0,  -2.0,
+     0.0,   0.0,   0.0,   0.0,   0.0,
+     2.0,  -8.0,  12.0,  -8.0,   2.0,
+     1.0,  -4.0,   6.0,  -4.0,   1.0
+};
+
+static const double LAWS_E5L5[] = {
+    -1.0,  -4.0,  -6.0,  -4.0,  -1.0,
+    -2.0,  -8.0, -12.0,  -8.0,  -2.0,
+     0.0,   0.0,   0.0,   0.0,   0.0,
+     2.0,   8.0,  12.0,   8.0,   2.0,
+     1.0,   4.0,   6.0,   4.0,   1.0
+};
+
+static const double LAWS_E5S5[] = {
+    1.0,  0.0, -2.0,  0.0,  1.0,
+    2.0,  0.0, -4.0,  0.0,  2.0,
+    0.0,  0.0,  0.0,  0.0,  0.0,
+   -2.0,  0.0,  4.0,  0.0, -2.0,
+   -1.0,  0.0,  2.0,  0.0, -1.0
+};
+
+static const double LAWS_R5E5[] = {
+    -1.0,  -2.0,   0.0,   2.0,   1.0,
+     4.0,   8.0,   0.0,  -8.0,  -4.0,
+    -6.0, -12.0,   0.0,  12.0,   6.0,
+     4.0,   8.0,   0.0,  -8.0,  -4.0,
+    -1.0,  -2.0,   0.0,   2.0,   1.0
+};
+
+static const double LAWS_R5R5[] = {
+     1.0,  -4.0,   6.0,  -4.0,   1.0,
+    -4.0,  16.0, -24.0,  16.0,  -4.0,
+     6.0, -24.0,  36.0, -24.0,   6.0,
+    -4.0,  16.0, -24.0,  16.0,  -4.0,
+     1.0,  -4.0,   6.0,  -4.0,   1.0
+};
+
+static const double LAWS_R5L5[] = {
+     1.0,   4.0,   6.0,   4.0,   1.0,
+    -4.0, -16.0, -24.0, -16.0,  -4.0,
+     6.0,  24.0,  36.0,  24.0,   6.0,
+    -4.0, -16.0, -24.0, -16.0,  -4.0,
+     1.0,   4.0,   6.0,   4.0,   1.0
+};
+
+static const double LAWS_R5S5[] = {
+    -1.0,   0.0,   2.0,   0.0,  -1.0,
+     4.0,   0.0,  -8.0,   0.0,   4.0,
+    -6.0,   0.0,  12.0,   0.0,  -6.0,
+     4.0,   0.0,  -8.0,   0.0,   4.0,
+    -1.0,   0.0,   2.0,   0.0,  -1.0
+};
+
+static const double LAWS_L5E5[] = {
+    -1.0,  -2.0,   0.0,   2.0,   1.0,
+    -4.0,  -8.0,   0.0,   8.0,   4.0,
+    -6.0, -12.0,   0.0,  12.0,   6.0,
+    -4.0,  -8.0,   0.0,   8.0,   4.0,
+    -1.0,  -2.0,   0.0,   2.0,   1.0
+};
+
+static const double LAWS_L5R5[] = {
+     1.0,  -4.0,   6.0,  -4.0,   1.0,
+     4.0, -16.0,  24.0, -16.0,   4.0,
+     6.0, -24.0,  36.0, -24.0,   6.0,
+     4.0, -16.0,  24.0, -16.0,   4.0,
+     1.0,  -4.0,   6.0,  -4.0,   1.0
+};
+
+static const double LAWS_L5L5[] = {
+     1.0,   4.0,   6.0,   4.0,   1.0,
+     4.0,  16.0,  24.0,  16.0,   4.0,
+     6.0,  24.0,  36.0,  24.0,   6.0,
+     4.0,  16.0,  24.0,  16.0,   4.0,
+     1.0,   4.0,   6.0,   4.0,   1.0
+};
+
+static const double LAWS_L5S5[] = {
+    -1.0,   0.0,   2.0,   0.0,  -1.0,
+    -4.0,   0.0,   8.0,   0.0,  -4.0,
+    -6.0,   0.0,  12.0,   0.0,  -6.0,
+    -4.0,   0.0,   8.0,   0.0,  -4.0,
+    -1.0,   0.0,   2.0,   0.0,  -1.0
+};
+
+static const double LAWS_S5E5[] = {
+    1.0,  2.0,  0.0, -2.0, -1.0,
+    0.0,  0.0,  0.0,  0.0,  0.0,
+   -2.0, -4.0,  0.0,  4.0,  2.0,
+    0.0,  0.0,  0.0,  0.0,  0.0,
+    1.0,  2.0,  0.0, -2.0, -1.0
+};
+
+static const double LAWS_S5R5[] = {
+    -1.0,   4.0,  -6.0,   4.0,  -1.0,
+     0.0,   0.0,   0.0,   0.0,   0.0,
+     2.0,  -8.0,  12.0,  -8.0,   2.0,
+     0.0,   0.0,   0.0,   0.0,   0.0,
+    -1.0,   4.0,  -6.0,   4.0,  -1.0
+};
+
+static const double LAWS_S5L5[] = {
+    -1.0,  -4.0,  -6.0,  -4.0,  -1.0,
+     0.0,   0.0,   0.0,   0.0,   0.0,
+     2.0,   8.0,  12.0,   8.0,   2.0,
+     0.0,   0.0,   0.0,   0.0,   0.0,
+    -1.0,  -4.0,  -6.0,  -4.0,  -1.0
+};
+
+static const double LAWS_S5S5[] = {
+    1.0,  0.0, -2.0,  0.0,  1.0,
+    0.0,  0.0,  0.0,  0.0,  0.0,
+   -2.0,  0.0,  4.0,  0.0, -2.0,
+    0.0,  0.0,  0.0,  0.0,  0.0,
+    1.0,  0.0, -2.0,  0.0,  1.0
+};
+
+static const Kernel<5> laws_masks[] = {
+    Kernel<5>(LAWS_E5E5),
+    Kernel<5>(LAWS_E5R5),
+    Kernel<5>(LAWS_E5L5),
+    Kernel<5>(LAWS_E5S5),
+    Kernel<5>(LAWS_R5E5),
+    Kernel<5>(LAWS_R5R5),
+    Kernel<5>(LAWS_R5L5),
+    Kernel<5>(LAWS_R5S5),
+    Kernel<5>(LAWS_L5E5),
+    Kernel<5>(LAWS_L5R5),
+    Kernel<5>(LAWS_L5L5),
+    Kernel<5>(LAWS_L5S5),
+    Kernel<5>(LAWS_S5E5),
+    Kernel<5>(LAWS_S5R5),
+    Kernel<5>(LAWS_S5L5),
+    Kernel<5>(LAWS_S5S5)
+};
+
+static const size_t LAWS_MASKS = sizeof(laws_masks) / sizeof(Kernel<5>);
+
 List<cv::Mat> filter::laws(const cv::Mat &data, size_t w) {
-    static const Kernel<5> *laws_masks[] = {
-        new Kernel<5>( // E5E5
-              1.0,  2.0,  0.0, -2.0, -1.0,
-              2.0,  4.0,  0.0, -4.0, -2.0,
-              0.0,  0.0,  0.0,  0.0,  0.0,
-             -2.0, -4.0,  0.0,  4.0,  2.0,
-             -1.0, -2.0,  0.0,  2.0,  1.0
-        ),
-
-        new Kernel<5>( // E5R5
-              -1.0,   4.0,  -6.0,   4.0,  -1.0,
-              -2.0,   8.0, -12.0,   8.0,  -2.0,
-               0.0,   0.0,   0.0,   0.0,   0.0,
-               2.0,  -8.0,  12.0,  -8.0,   2.0,
-               1.0,  -4.0,   6.0,  -4.0,   1.0
-        ),
-
-        new Kernel<5>( // E5L5
-              -1.0,  -4.0,  -6.0,  -4.0,  -1.0,
-              -2.0,  -8.0, -12.0,  -8.0,  -2.0,
-               0.0,   0.0,   0.0,   0.0,   0.0,
-               2.0,   8.0,  12.0,   8.0,   2.0,
-               1.0,   4.0,   6.0,   4.0,   1.0
-        ),
-
-        new Kernel<5>( // E5S5
-              1.0,  0.0, -2.0,  0.0,  1.0,
-              2.0,  0.0, -4.0,  0.0,  2.0,
-              0.0,  0.0,  0.0,  0.0,  0.0,
-             -2.0,  0.0,  4.0,  0.0, -2.0,
-             -1.0,  0.0,  2.0,  0.0, -1.0
-        ),
-
-        new Kernel<5>( // R5E5
-              -1.0,  -2.0,   0.0,   2.0,   1.0,
-               4.0,   8.0,   0.0,  -8.0,  -4.0,
-              -6.0, -12.0,   0.0,  12.0,   6.0,
-               4.0,   8.0,   0.0,  -8.0,  -4.0,
-              -1.0,  -2.0,   0.0,   2.0,   1.0
-        ),
-
-        new Kernel<5>( // R5R5
-               1.0,  -4.0,   6.0,  -4.0,   1.0,
-              -4.0,  16.0, -24.0,  16.0,  -4.0,
-               6.0, -24.0,  36.0, -24.0,   6.0,
-              -4.0,  16.0, -24.0,  16.0,  -4.0,
-               1.0,  -4.0,   6.0,  -4.0,   1.0
-        ),
-
-        new Kernel<5>( // R5L5
-               1.0,   4.0,   6.0,   4.0,   1.0,
-              -4.0, -16.0, -24.0, -16.0,  -4.0,
-               6.0,  24.0,  36.0,  24.0,   6.0,
-              -4.0, -16.0, -24.0, -16.0,  -4.0,
-               1.0,   4.0,   6.0,   4.0,   1.0
-        ),
-
-        new Kernel<5>( // R5S5
-              -1.0,   0.0,   2.0,   0.0,  -1.0,
-               4.0,   0.0,  -8.0,   0.0,   4.0,
-              -6.0,   0.0,  12.0,   0.0,  -6.0,
-               4.0,   0.0,  -8.0,   0.0,   4.0,
-              -1.0,   0.0,   2.0,   0.0,  -1.0
-        ),
-
-        new Kernel<5>( // L5E5
-              -1.0,  -2.0,   0.0,   2.0,   1.0,
-              -4.0,  -8.0,   0.0,   8.0,   4.0,
-              -6.0, -12.0,   0.0,  12.0,   6.0,
-              -4.0,  -8.0,   0.0,   8.0,   4.0,
-              -1.0,  -2.0,   0.0,   2.0,   1.0
-        ),
-
-        new Kernel<5>( // L5R5
-               1.0,  -4.0,   6.0,  -4.0,   1.0,
-               4.0, -16.0,  24.0, -16.0,   4.0,
-               6.0, -24.0,  36.0, -24.0,   6.0,
-               4.0, -16.0,  24.0, -16.0,   4.0,
-               1.0,  -4.0,   6.0,  -4.0,   1.0
-        ),
-
-        new Kernel<5>( // L5L5
-               1.0,   4.0,   6.0,   4.0,   1.0,
-               4.0,  16.0,  24.0,  16.0,   4.0,
-               6.0,  24.0,  36.0,  24.0,   6.0,
-               4.0,  16.0,  24.0,  16.0,   4.0,
-               1.0,   4.0,   6.0,   4.0,   1.0
-        ),
-
-        new Kernel<5>( // L5S5
-              -1.0,   0.0,   2.0,   0.0,  -1.0,
-              -4.0,   0.0,   8.0,   0.0,  -4.0,
-              -6.0,   0.0,  12.0,   0.0,  -6.0,
-              -4.0,   0.0,   8.0,   0.0,  -4.0,
-              -1.0,   0.0,   2.0,   0.0,  -1.0
-        ),
-
-        new Kernel<5>( // S5E5
-              1.0,  2.0,  0.0, -2.0, -1.0,
-              0.0,  0.0,  0.0,  0.0,  0.0,
-             -2.0, -4.0,  0.0,  4.0,  2.0,
-              0.0,  0.0,  0.0,  0.0,  0.0,
-              1.0,  2.0,  0.0, -2.0, -1.0
-        ),
-
-        new Kernel<5>( // S5R5
-              -1.0,   4.0,  -6.0,   4.0,  -1.0,
-               0.0,   0.0,   0.0,   0.0,   0.0,
-               2.0,  -8.0,  12.0,  -8.0,   2.0,
-               0.0,   0.0,   0.0,   0.0,   0.0,
-              -1.0,   4.0,  -6.0,   4.0,  -1.0
-        ),
-
-        new Kernel<5>( // S5L5
-              -1.0,  -4.0,  -6.0,  -4.0,  -1.0,
-               0.0,   0.0,   0.0,   0.0,   0.0,
-               2.0,   8.0,  12.0,   8.0,   2.0,
-               0.0,   0.0,   0.0,   0.0,   0.0,
-              -1.0,  -4.0,  -6.0,  -4.0,  -1.0
-        ),
-
-        new Kernel<5>( // S5S5
-              1.0,  0.0, -2.0,  0.0,  1.0,
-              0.0,  0.0,  0.0,  0.0,  0.0,
-             -2.0,  0.0,  4.0,  0.0, -2.0,
-              0.0,  0.0,  0.0,  0.0,  0.0,
-              1.0,  0.0, -2.0,  0.0,  1.0
-        ),
-
-        NULL // End-of-array marking, do not remove
-    };
 
     // Mask indices
     static const size_t E5E5 = 0;
@@ -282,9 +417,8 @@ List<cv::Mat> filter::laws(const cv::Mat &data, size_t w) {
 
     List<cv::Mat> maps;
     cv::Mat values = normalize(data, w);
-    for (const Kernel<5> **k = laws_masks; *k != NULL; k++) {
-        const Kernel<5> &kernel = **k;
-        cv::Mat e = energy(kernel(values), w);
+    for (size_t k = 0; k < LAWS_MASKS; k++) {
+        cv::Mat e = energy(laws_masks[k](values), w);
         maps.append(e);
     }
 
@@ -341,103 +475,77 @@ cv::Mat filter::otsu(const cv::Mat &image, int type) {
     return out;
 }
 
-List<cv::Mat> filter::prewitt(const cv::Mat &l) {
-    static const Kernel<5>* prewitt_kernels[] = {
-        new Kernel<5>(
-            -1, -1,  0,  1,  1,
-            -1, -1,  0,  1,  1,
-            -1, -1,  0,  1,  1,
-            -1, -1,  0,  1,  1,
-            -1, -1,  0,  1,  1
-        ),
-
-        new Kernel<5>(
-            -1,  0,  1,  1,  1,
-            -1, -1,  1,  1,  1,
-            -1, -1,  0,  1,  1,
-            -1, -1, -1,  1,  1,
-            -1, -1, -1,  0,  1
-        ),
-
-        new Kernel<5>(
-             1,  1,  1,  1,  1,
-             0,  1,  1,  1,  1,
-            -1, -1,  0,  1,  1,
-            -1, -1, -1, -1,  0,
-            -1, -1, -1, -1, -1
-        ),
-
-        new Kernel<5>(
-             1,  1,  1,  1,  1,
-             1,  1,  1,  1,  1,
-             0,  0,  0,  0,  0,
-            -1, -1, -1, -1, -1,
-            -1, -1, -1, -1, -1
-        ),
-
-        new Kernel<5>(
-             1,  1,  1,  1,  1,
-             1,  1,  1,  1,  0,
-             1,  1,  0, -1, -1,
-             0, -1, -1, -1, -1,
-            -1, -1, -1, -1, -1
-        ),
-
-        new Kernel<5>(
-             1,  1,  1,  0, -1,
-             1,  1,  1, -1, -1,
-             1,  1,  0, -1, -1,
-             1,  1, -1, -1, -1,
-             1,  0, -1, -1, -1
-        ),
-
-        NULL // End-of-array marking, do not remove
-    };
-
-    List<cv::Mat> maps;
-    for (const Kernel<5> **k = prewitt_kernels; *k != NULL; k++) {
-        const Kernel<5> &kernel = **k;
-        maps.append(kernel(l));
+/*
+Prewitt compass masks for six edge directions.
+*/
+static const double PREWITT[][25] = {
+    {
+        -1.0, -1.0,  0.0,  1.0,  1.0,
+        -1.0, -1.0,  0.0,  1.0,  1.0,
+        -1.0, -1.0,  0.0,  1.0,  1.0,
+        -1.0, -1.0,  0.0,  1.0,  1.0,
+        -1.0, -1.0,  0.0,  1.0,  1.0
+    },
+
+    {
+        -1.0,  0.0,  1.0,  1.0,  1.0,
+        -1.0, -1.0,  1.0,  1.0,  1.0,
+        -1.0, -1.0,  0.0,  1.0,  1.0,
+        -1.0, -1.0, -1.0,  1.0,  1.0,
+        -1.0, -1.0, -1.0,  0.0,  1.0
+    },
+
+    {
+         1.0,  1.0,  1.0,  1.0,  1.0,
+         0.0,  1.0,  1.0,  1.0,  1.0,
+        -1.0, -1.0,  0.0,  1.0,  1.0,
+        -1.0, -1.0, -1.0, -1.0,  0.0,
+        -1.0, -1.0, -1.0, -1.0, -1.0
+    },
+
+    {
+         1.0,  1.0,  1.0,  1.0,  1.0,
+         1.0,  1.0,  1.0,  1.0,  1.0,
+         0.0,  0.0,  0.0,  0.0,  0.0,
+        -1.0, -1.0, -1.0, -1.0, -1.0,
+        -1.0, -1.0, -1.0, -1.0, -1.0
+    },
+
+    {
+         1.0,  1.0,  1.0,  1.0,  1.0,
+         1.0,  1.0,  1.0,  1.0,  0.0,
+         1.0,  1.0,  0.0, -1.0, -1.0,
+         0.0, -1.0, -1.0, -1.0, -1.0,
+        -1.0, -1.0, -1.0, -1.0, -1.0
+    },
+
+    {
+         1.0,  1.0,  1.0,  0.0, -1.0,
+         1.0,  1.0,  1.0, -1.0, -1.0,
+         1.0,  1.0,  0.0, -1.0, -1.0,
+         1.0,  1.0, -1.0, -1.0, -1.0,
+         1.0,  0.0, -1.0, -1.0, -1.0
     }
+};
 
-    return maps;
-}
-
-cv::Mat filter::sobel(const cv::Mat &image) {
-    List<cv::Mat> channels;
-    cv::split(image, *channels);
-
-    cv::Mat result = cv::Mat::zeros(image.size(), CV_64F);
-    for (ListIterator<cv::Mat> i(channels); i.more();) {
-        const cv::Mat &l = i.next();
-        cv::Mat g, x, y, e;
-
-        // Gradient X
-        cv::Sobel(l, x, CV_64F, 1, 0, 3, 1, 0, cv::BORDER_DEFAULT);
-        //cv::convertScaleAbs(g, x);
-
-        // Gradient Y
-        cv::Sobel(l, y, CV_64F, 0, 1, 3, 1, 0, cv::BORDER_DEFAULT);
-        //cv::convertScaleAbs(g, y);
-
-        cv::Mat x_2, y_2, g_2;
-
-        cv::pow(x, 2.0, x_2);
-        cv::pow(y, 2.0, y_2);
-        g_2 = x_2 + y_2;
-        cv::pow(g_2, 0.5, g);
+static const Kernel<5> prewitt_kernels[] = {
+    Kernel<5>(PREWITT[0]),
+    Kernel<5>(PREWITT[1]),
+    Kernel<5>(PREWITT[2]),
+    Kernel<5>(PREWITT[3]),
+    Kernel<5>(PREWITT[4]),
+    Kernel<5>(PREWITT[5])
+};
 
-        result += g;
+static const size_t PREWITT_KERNELS = sizeof(prewitt_kernels) / sizeof(Kernel<5>);
 
-        //result += 0.5 * x + 0.5 * y;
-
-        // Total Gradient (approximate)
-//         cv::addWeighted(x, 0.5, y, 0.5, 0, g);
-//         cv::convertScaleAbs(g, e);
-//         e.copyTo(result, e);
-    }
+List<cv::Mat> filter::prewitt(const cv::Mat &l) {
+    // All directions are computed in a single pass over the input.
+    return Kernel<5>::apply(prewitt_kernels, PREWITT_KERNELS, l);
+}
 
-    return result;
+cv::Mat filter::sobel(const cv::Mat &image) {
+    return gradient(image, CV_64F);
 }
 
 cv::Mat filter::suppress(const cv::Mat &edges) {
@@ -498,39 +606,11 @@ https://github.com/bytefish/opencv/blob/master/misc/tan_triggs.cpp
 cv::Mat filter::tantriggs(const cv::Mat &image, double a, double t, double g, double w0, double w1) {
     CHANNEL_WISE(tantriggs, image, a, t, g, w0, w1);
 
-    // Convert to floating point
-    cv::Mat output;
-    image.convertTo(output, CV_64FC1);
-
-    // Gamma correction
-    output = gamma(output, g);
-
-    // Difference of gaussians
-    output = gaussian::difference(output, w0, w1);
+    // Gamma correction, difference of gaussians, contrast equalization and conversion
+    // to 8-bit, computed in four passes over shared buffers.
+    pipeline::Graph graph;
+    graph.tantriggs(pipeline::Graph::INPUT, a, t, g, w0, w1);
 
-    //return colors::discrete(output);
-
-    // Constrast equalization parameters
-    cv::Mat absd = cv::abs(output);
-    cv::Mat mind = cv::min(absd, t);
-
-    // Constrast equalization (first part)
-    cv::Mat powd;
-    cv::pow(absd, a, powd);
-    double mean1 = cv::mean(powd)[0];
-    output = output / ::pow(mean1, 1.0 / a);
-
-    // Constrast equalization (second part)
-    cv::pow(mind, a, powd);
-    double mean2 = cv::mean(powd)[0];
-    output = output / ::pow(mean2, 1.0 / a);
-
-    // Constrast equalization (third part)
-    for(int i = 0, m = output.rows; i < m; i++) {
-        for(int j = 0, n = output.cols; j < n; j++) {
-            output.at<double>(i, j) = t * tanh(output.at<double>(i, j) / t);
-        }
-    }
-
-    return colors::discrete(output);
+    cv::Mat output = graph(image);
+    return output;
 }
@@ -17,9 +17,12 @@ You should have received a copy of the GNU General Public License
 along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <clarus/core/parallel.hpp>
 #include <clarus/vision/cvmat.hpp>
 #include <clarus/vision/fourier.hpp>
 
+#include <boost/bind.hpp>
+
 #include <stdexcept>
 
 cv::Size fourier::fit(int width, int height)
@@ -197,6 +200,22 @@ cv::Mat fourier::phase(const cv::Mat &fourier)
   return pha;
 }
 
+static void hls_band(const cv::Mat &pha, const cv::Mat &mag, cv::Mat &hls, const clarus::parallel::Band &band)
+{
+  for (int i = band.rows.start, n = hls.cols; i < band.rows.end; i++)
+  {
+    const float *h = pha.ptr<float>(i);
+    const float *l = mag.ptr<float>(i);
+    cv::Vec3b *pixel = hls.ptr<cv::Vec3b>(i);
+    for (int j = 0; j < n; j++, h++, l++, pixel++)
+    {
+      (*pixel)[0] = (uchar) *h;
+      (*pixel)[1] = (uchar) *l;
+      (*pixel)[2] = 255;
+    }
+  }
+}
+
 cv::Mat fourier::bgr(const cv::Mat &fourier)
 {
   const cv::Size &size = fourier.size();
@@ -215,16 +234,7 @@ cv::Mat fourier::bgr(const cv::Mat &fourier)
   cv::phase(plane[1], plane[0], pha);
   cv::normalize(pha, pha, 0, 127, CV_MINMAX);
 
-  for (int i = 0, m = size.height; i < m; i++)
-  {
-    for (int j = 0, n = size.width; j < n; j++)
-    {
-      cv::Vec3b &pixel = hls.at<cv::Vec3b>(i, j);
-      pixel[0] = (uchar) pha.at<float>(i, j);
-      pixel[1] = (uchar) mag.at<float>(i, j);
-      pixel[2] = 255;
-    }
-  }
+  clarus::parallel::bands(size.height, 0, boost::bind(hls_band, boost::cref(pha), boost::cref(mag), boost::ref(hls), _1));
 
   cv::Mat rgb;
   cv::cvtColor(hls, rgb, CV_HLS2BGR);
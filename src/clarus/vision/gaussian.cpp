@@ -19,8 +19,130 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/vision/gaussian.hpp>
 
+#include <clarus/core/parallel.hpp>
+using clarus::List;
+using clarus::parallel::Band;
+
 #include <clarus/vision/filters.hpp>
 
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/*
+Coefficients of the Young - van Vliet recursive filter, normalized by b0.
+*/
+struct RecursiveGaussian {
+    double B;
+
+    double b1;
+
+    double b2;
+
+    double b3;
+
+    RecursiveGaussian(double sigma) {
+        double q = (
+            sigma >= 2.5 ?
+            0.98711 * sigma - 0.96330 :
+            3.97156 - 4.14554 * ::sqrt(1.0 - 0.26891 * sigma)
+        );
+
+        double q2 = q * q;
+        double q3 = q2 * q;
+        double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+
+        b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+        b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+        b3 = (0.422205 * q3) / b0;
+        B = 1.0 - (b1 + b2 + b3);
+    }
+};
+
+/*
+Runs the recursion forward and backward across each row of the band, in place.
+
+Since the filter's DC gain is one, the first output of each pass equals its input;
+seeding the recursion with that value replicates the edge pixels.
+*/
+static void recurse_rows(const RecursiveGaussian &r, cv::Mat &data, const Band &band) {
+    int cn = data.channels();
+    int n = data.cols * cn;
+    for (int i = band.rows.start; i < band.rows.end; i++) {
+        double *x = data.ptr<double>(i);
+        for (int c = 0; c < cn; c++) {
+            double w1 = x[c];
+            double w2 = w1;
+            double w3 = w1;
+            for (int j = c; j < n; j += cn) {
+                double w = r.B * x[j] + r.b1 * w1 + r.b2 * w2 + r.b3 * w3;
+                x[j] = w;
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+            }
+
+            w1 = x[n - cn + c];
+            w2 = w1;
+            w3 = w1;
+            for (int j = n - cn + c; j >= 0; j -= cn) {
+                double w = r.B * x[j] + r.b1 * w1 + r.b2 * w2 + r.b3 * w3;
+                x[j] = w;
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+            }
+        }
+    }
+}
+
+/*
+Runs the recursion forward and backward down the given range of columns, in place.
+
+Whole row segments are updated at once, so memory is still traversed row by row.
+Neighbor row indices are clamped to the matrix, which seeds the recursion with the
+edge rows (see recurse_rows()).
+*/
+static void recurse_columns(const RecursiveGaussian &r, cv::Mat &data, const cv::Range &columns) {
+    int rows = data.rows;
+    int a = columns.start;
+    int b = columns.end;
+    for (int i = 0; i < rows; i++) {
+        double *x = data.ptr<double>(i);
+        const double *w1 = data.ptr<double>(std::max(i - 1, 0));
+        const double *w2 = data.ptr<double>(std::max(i - 2, 0));
+        const double *w3 = data.ptr<double>(std::max(i - 3, 0));
+        for (int j = a; j < b; j++) {
+            x[j] = r.B * x[j] + r.b1 * w1[j] + r.b2 * w2[j] + r.b3 * w3[j];
+        }
+    }
+
+    for (int i = rows - 1; i >= 0; i--) {
+        double *x = data.ptr<double>(i);
+        const double *w1 = data.ptr<double>(std::min(i + 1, rows - 1));
+        const double *w2 = data.ptr<double>(std::min(i + 2, rows - 1));
+        const double *w3 = data.ptr<double>(std::min(i + 3, rows - 1));
+        for (int j = a; j < b; j++) {
+            x[j] = r.B * x[j] + r.b1 * w1[j] + r.b2 * w2[j] + r.b3 * w3[j];
+        }
+    }
+}
+
+/*
+Runs recurse_columns() over the given range of column blocks, each block columns wide
+(the last may be narrower). Each task thus sweeps a contiguous run of every row, and tasks
+share at most the cache line at the boundary between their blocks.
+*/
+static void recurse_blocks(const RecursiveGaussian &r, cv::Mat &data, int block, const cv::Range &blocks) {
+    int width = data.cols * data.channels();
+    for (int k = blocks.start; k < blocks.end; k++) {
+        recurse_columns(r, data, cv::Range(k * block, std::min((k + 1) * block, width)));
+    }
+}
+
 cv::Mat gaussian::blur(
     const cv::Mat &image,
     const cv::Size &size,
@@ -49,3 +171,63 @@ cv::Mat gaussian::difference(const cv::Mat &image, double w0, double w1) {
     cv::Mat blurred1 = blur(image, w1);
     return blurred0 - blurred1;
 }
+
+cv::Mat gaussian::recursive(const cv::Mat &image, double sigma) {
+    if (sigma <= 0) {
+        throw std::runtime_error((boost::format("Invalid standard deviation %1%") % sigma).str());
+    }
+
+    cv::Mat blurred;
+    image.convertTo(blurred, CV_MAKETYPE(CV_64F, image.channels()));
+    if (blurred.empty()) {
+        return blurred;
+    }
+
+    if (sigma < 0.5) {
+        cv::GaussianBlur(blurred, blurred, cv::Size(0, 0), sigma, sigma, cv::BORDER_REPLICATE);
+        return blurred;
+    }
+
+    RecursiveGaussian r(sigma);
+    clarus::parallel::bands(blurred.rows, 0, boost::bind(recurse_rows, boost::cref(r), boost::ref(blurred), _1));
+
+    // Split the columns in a few contiguous blocks per worker, each a multiple of 8 doubles
+    // (one 64-byte cache line) wide.
+    int width = blurred.cols * blurred.channels();
+    int tasks = clarus::parallel::workers() * 4;
+    int block = ((width + tasks - 1) / tasks + 7) / 8 * 8;
+    int blocks = (width + block - 1) / block;
+    clarus::parallel::run(blocks, boost::bind(recurse_blocks, boost::cref(r), boost::ref(blurred), block, _1));
+    return blurred;
+}
+
+List<cv::Mat> gaussian::scales(const cv::Mat &image, double sigma0, double k, int n) {
+    if (k <= 1.0) {
+        throw std::runtime_error((boost::format("Scale factor must be greater than 1, got %1%") % k).str());
+    }
+
+    List<cv::Mat> levels;
+    if (n < 1) {
+        return levels;
+    }
+
+    double sigma = sigma0;
+    levels.append(recursive(image, sigma));
+    for (int i = 1; i < n; i++) {
+        double next = sigma * k;
+        levels.append(recursive(levels[i - 1], ::sqrt(next * next - sigma * sigma)));
+        sigma = next;
+    }
+
+    return levels;
+}
+
+List<cv::Mat> gaussian::differences(const cv::Mat &image, double sigma0, double k, int n) {
+    List<cv::Mat> levels = scales(image, sigma0, k, n + 1);
+    List<cv::Mat> pyramid;
+    for (int i = 0; i < n; i++) {
+        pyramid.append(levels[i] - levels[i + 1]);
+    }
+
+    return pyramid;
+}
@@ -22,9 +22,11 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 #include <clarus/core/list.hpp>
 using clarus::List;
 
+#include <clarus/core/parallel.hpp>
 #include <clarus/vision/colors.hpp>
 #include <clarus/vision/filters.hpp>
 
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 
 #include <iostream>
@@ -54,27 +56,40 @@ inline cv::Mat reduce(const cv::Mat &diff, int type)
 }
 
 template<class T>
-inline cv::Mat reduce_(const cv::Mat &diff, int type)
+static void reduce_band(const cv::Mat &diff, cv::Mat &out, const clarus::parallel::Band &band)
 {
-  cv::Mat out(diff.size(), type, cv::Scalar(0));
-
-  const cv::Vec3b *u = (const cv::Vec3b*) diff.data;
-  T *v = (T*) out.data;
-  for (int i = 0, n = diff.rows * diff.cols; i < n; i++, u++, v++)
-    *v = (*u)[0] + (*u)[1] + (*u)[2];
+  for (int i = band.rows.start, n = diff.cols; i < band.rows.end; i++)
+  {
+    const cv::Vec3b *u = diff.ptr<cv::Vec3b>(i);
+    T *v = out.ptr<T>(i);
+    for (int j = 0; j < n; j++, u++, v++)
+      *v = (*u)[0] + (*u)[1] + (*u)[2];
+  }
+}
 
+template<class T>
+inline cv::Mat reduce_(const cv::Mat &diff, int type)
+{
+  cv::Mat out(diff.size(), type);
+  clarus::parallel::bands(diff.rows, 0, boost::bind(reduce_band<T>, boost::cref(diff), boost::ref(out), _1));
   return out;
 }
 
-inline cv::Mat reduce_8u(const cv::Mat &diff)
+static void reduce_8u_band(const cv::Mat &diff, cv::Mat &out, const clarus::parallel::Band &band)
 {
-  cv::Mat out(diff.size(), CV_8U, cv::Scalar(0));
-
-  const cv::Vec3b *u = (const cv::Vec3b*) diff.data;
-  uint8_t *v = (uint8_t*) out.data;
-  for (int i = 0, n = diff.rows * diff.cols; i < n; i++, u++, v++)
-    *v = std::min((*u)[0] + (*u)[1] + (*u)[2], 255);
+  for (int i = band.rows.start, n = diff.cols; i < band.rows.end; i++)
+  {
+    const cv::Vec3b *u = diff.ptr<cv::Vec3b>(i);
+    uint8_t *v = out.ptr<uint8_t>(i);
+    for (int j = 0; j < n; j++, u++, v++)
+      *v = std::min((*u)[0] + (*u)[1] + (*u)[2], 255);
+  }
+}
 
+inline cv::Mat reduce_8u(const cv::Mat &diff)
+{
+  cv::Mat out(diff.size(), CV_8U);
+  clarus::parallel::bands(diff.rows, 0, boost::bind(reduce_8u_band, boost::cref(diff), boost::ref(out), _1));
   return out;
 }
 
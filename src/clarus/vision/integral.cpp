@@ -19,27 +19,219 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/vision/integral.hpp>
 
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
 namespace clarus
 {
 
-Integral::Integral()
+/**
+ * \brief Throw a `std::runtime_error` if the given area is not contained in the table's image.
+ */
+inline void check(const cv::Mat &table, const cv::Rect &roi)
 {
-  // Nothing to do.
+  if (table.empty())
+    throw std::runtime_error("Integral table was not computed");
+
+  if (
+    roi.x < 0 || roi.y < 0 || roi.width < 0 || roi.height < 0 ||
+    roi.x + roi.width >= table.cols || roi.y + roi.height >= table.rows
+  )
+    throw std::runtime_error(
+      (boost::format("Area (%1%, %2%, %3%, %4%) out of integral image bounds %5%")
+        % roi.x % roi.y % roi.width % roi.height % cv::Size(table.cols - 1, table.rows - 1)).str()
+    );
+}
+
+/**
+ * \brief Return the sum over the given area, read from the table's raw row pointers.
+ *
+ * Sums are computed in the table's own arithmetic, so that wrapped-around entries of
+ * unsigned integer tables still produce exact results.
+ */
+template<class S>
+inline double area(const cv::Mat &table, int i0, int j0, int rows, int cols)
+{
+  const S *top = (const S*) table.ptr(i0);
+  const S *bottom = (const S*) table.ptr(i0 + rows);
+  int jn = j0 + cols;
+
+  S value = top[j0] + bottom[jn] - top[jn] - bottom[j0];
+  return value;
 }
 
-Integral::Integral(const cv::Mat &image)
+inline double area(const cv::Mat &table, int i0, int j0, int rows, int cols)
 {
-  cv::integral(image, integral, CV_64F);
-  cv::integral(image.mul(image), integral2, CV_64F);
+  if (table.type() == CV_32S)
+    return area<uint32_t>(table, i0, j0, rows, cols);
+
+  return area<double>(table, i0, j0, rows, cols);
+}
+
+template<class S>
+static cv::Mat areas(const cv::Mat &table, const List<cv::Rect> &rois, bool average)
+{
+  const std::vector<cv::Rect> &r = *rois;
+  int n = r.size();
+
+  cv::Mat values(n, 1, CV_64F);
+  double *v = values.ptr<double>();
+  for (int k = 0; k < n; k++)
+  {
+    const cv::Rect &roi = r[k];
+    check(table, roi);
+    v[k] = area<S>(table, roi.y, roi.x, roi.height, roi.width);
+    if (average)
+      v[k] /= roi.area();
+  }
+
+  return values;
+}
+
+static cv::Mat areas(const cv::Mat &table, const List<cv::Rect> &rois, bool average)
+{
+  if (table.type() == CV_32S)
+    return areas<uint32_t>(table, rois, average);
+
+  return areas<double>(table, rois, average);
 }
 
-Integral::Integral(const cv::Mat &image, bool compute_integral, bool compute_integral2)
+template<class S>
+static void statistics(
+  const cv::Mat &integral,
+  const cv::Mat &integral2,
+  const List<cv::Rect> &rois,
+  cv::Mat &means,
+  cv::Mat &deviations)
+{
+  const std::vector<cv::Rect> &r = *rois;
+  int n = r.size();
+
+  means.create(n, 1, CV_64F);
+  deviations.create(n, 1, CV_64F);
+  double *u = means.ptr<double>();
+  double *d = deviations.ptr<double>();
+  for (int k = 0; k < n; k++)
+  {
+    const cv::Rect &roi = r[k];
+    check(integral, roi);
+    check(integral2, roi);
+
+    double a = roi.area();
+    double m = area<S>(integral, roi.y, roi.x, roi.height, roi.width) / a;
+    double m2 = area<double>(integral2, roi.y, roi.x, roi.height, roi.width) / a;
+    u[k] = m;
+
+    // Rounding errors may turn the variance of flat areas slightly negative.
+    d[k] = ::sqrt(std::max(m2 - m * m, 0.0));
+  }
+}
+
+/**
+ * \brief Compute the table entries below and to the right of the given corner.
+ *
+ * Entries at column \c j0 and row \c i0 only depend on pixels above or to the left of the
+ * corner, so they are used to seed running row sums for the rest of the table. Both tables
+ * are updated in the same pass over the image.
+ */
+template<class P, class S, class Q, bool sums, bool squares>
+static void accumulate(const cv::Mat &image, cv::Mat &integral, cv::Mat &integral2, int i0, int j0)
+{
+  for (int i = i0 + 1, m = image.rows + 1, n = image.cols + 1; i < m; i++)
+  {
+    const P *pixel = image.ptr<P>(i - 1) + j0;
+
+    S *row_s = (sums ? (S*) integral.ptr(i) : NULL);
+    const S *above_s = (sums ? (const S*) integral.ptr(i - 1) : NULL);
+    S s = (sums ? row_s[j0] - above_s[j0] : 0);
+
+    Q *row_q = (squares ? (Q*) integral2.ptr(i) : NULL);
+    const Q *above_q = (squares ? (const Q*) integral2.ptr(i - 1) : NULL);
+    Q q = (squares ? row_q[j0] - above_q[j0] : 0);
+
+    for (int j = j0 + 1; j < n; j++, pixel++)
+    {
+      if (sums)
+      {
+        s += *pixel;
+        row_s[j] = above_s[j] + s;
+      }
+
+      if (squares)
+      {
+        Q v = *pixel;
+        q += v * v;
+        row_q[j] = above_q[j] + q;
+      }
+    }
+  }
+}
+
+template<class P, class S>
+static void accumulate(const cv::Mat &image, cv::Mat &integral, cv::Mat &integral2, int i0, int j0)
+{
+  bool sums = !integral.empty();
+  bool squares = !integral2.empty();
+  if (sums && squares)
+    accumulate<P, S, double, true, true>(image, integral, integral2, i0, j0);
+  else if (sums)
+    accumulate<P, S, double, true, false>(image, integral, integral2, i0, j0);
+  else if (squares)
+    accumulate<P, S, double, false, true>(image, integral, integral2, i0, j0);
+}
+
+static void accumulate(const cv::Mat &image, cv::Mat &integral, cv::Mat &integral2, int i0, int j0)
+{
+  switch (image.type())
+  {
+    case CV_8U:  accumulate<uchar, uint32_t>(image, integral, integral2, i0, j0); break;
+    case CV_16U: accumulate<ushort, double>(image, integral, integral2, i0, j0);  break;
+    case CV_32F: accumulate<float, double>(image, integral, integral2, i0, j0);   break;
+    case CV_64F: accumulate<double, double>(image, integral, integral2, i0, j0);  break;
+    default: throw std::runtime_error("Integral image source must be single-channel CV_8U, CV_16U, CV_32F or CV_64F");
+  }
+}
+
+/**
+ * \brief Allocate a summed area table for the given image, zeroing its first row and column.
+ */
+static void allocate(cv::Mat &table, const cv::Mat &image, int type)
+{
+  table.create(image.rows + 1, image.cols + 1, type);
+  table.row(0).setTo(cv::Scalar(0));
+  table.col(0).setTo(cv::Scalar(0));
+}
+
+static void compute(const cv::Mat &image, cv::Mat &integral, cv::Mat &integral2, bool compute_integral, bool compute_integral2)
 {
   if (compute_integral)
-    cv::integral(image, integral, CV_64F);
+    allocate(integral, image, image.type() == CV_8U ? CV_32S : CV_64F);
 
   if (compute_integral2)
-    cv::integral(image.mul(image), integral2, CV_64F);
+    allocate(integral2, image, CV_64F);
+
+  accumulate(image, integral, integral2, 0, 0);
+}
+
+Integral::Integral():
+  type(-1)
+{
+  // Nothing to do.
+}
+
+Integral::Integral(const cv::Mat &image):
+  type(image.type())
+{
+  compute(image, integral, integral2, true, true);
+}
+
+Integral::Integral(const cv::Mat &image, bool compute_integral, bool compute_integral2):
+  type(image.type())
+{
+  compute(image, integral, integral2, compute_integral, compute_integral2);
 }
 
 bool Integral::empty() const
@@ -47,6 +239,16 @@ bool Integral::empty() const
   return (integral.empty() && integral2.empty());
 }
 
+void Integral::update(const cv::Mat &image, const cv::Rect &roi)
+{
+  const cv::Mat &table = (integral.empty() ? integral2 : integral);
+  if (image.type() != type || image.rows + 1 != table.rows || image.cols + 1 != table.cols)
+    throw std::runtime_error("Updated image must be of same size and type as the original");
+
+  check(table, roi);
+  accumulate(image, integral, integral2, roi.y, roi.x);
+}
+
 double Integral::magnitude(const cv::Rect roi) const
 {
   return ::sqrt(sum2(roi));
@@ -69,6 +271,11 @@ double Integral::mean(int i0, int j0, int rows, int cols) const
   return sum(i0, j0, rows, cols) / n;
 }
 
+cv::Mat Integral::mean(const List<cv::Rect> &rois) const
+{
+  return areas(integral, rois, true);
+}
+
 double Integral::mean2(const cv::Rect roi) const
 {
   double n = roi.width * roi.height;
@@ -83,46 +290,32 @@ double Integral::mean2(int i0, int j0, int rows, int cols) const
 
 double Integral::sum(const cv::Rect roi) const
 {
-  int i0 = roi.y;
-  int j0 = roi.x;
-  int in = i0 + roi.height;
-  int jn = j0 + roi.height;
-
-  return
-    integral.at<double>(i0, j0) + integral.at<double>(in, jn) -
-    integral.at<double>(i0, jn) - integral.at<double>(in, j0);
+  return sum(roi.y, roi.x, roi.height, roi.width);
 }
 
 double Integral::sum(int i0, int j0, int rows, int cols) const
 {
-  int in = i0 + rows;
-  int jn = j0 + cols;
+  return area(integral, i0, j0, rows, cols);
+}
 
-  return
-    integral.at<double>(i0, j0) + integral.at<double>(in, jn) -
-    integral.at<double>(i0, jn) - integral.at<double>(in, j0);
+cv::Mat Integral::sum(const List<cv::Rect> &rois) const
+{
+  return areas(integral, rois, false);
 }
 
 double Integral::sum2(const cv::Rect roi) const
 {
-  int i0 = roi.y;
-  int j0 = roi.x;
-  int in = i0 + roi.height;
-  int jn = j0 + roi.height;
-
-  return
-    integral2.at<double>(i0, j0) + integral2.at<double>(in, jn) -
-    integral2.at<double>(i0, jn) - integral2.at<double>(in, j0);
+  return sum2(roi.y, roi.x, roi.height, roi.width);
 }
 
 double Integral::sum2(int i0, int j0, int rows, int cols) const
 {
-  int in = i0 + rows;
-  int jn = j0 + cols;
+  return area(integral2, i0, j0, rows, cols);
+}
 
-  return
-    integral2.at<double>(i0, j0) + integral2.at<double>(in, jn) -
-    integral2.at<double>(i0, jn) - integral2.at<double>(in, j0);
+cv::Mat Integral::sum2(const List<cv::Rect> &rois) const
+{
+  return areas(integral2, rois, false);
 }
 
 double Integral::standardDeviation(const cv::Rect roi) const
@@ -139,4 +332,19 @@ double Integral::standardDeviation(int i0, int j0, int rows, int cols) const
   return ::sqrt(m2 - m * m);
 }
 
+cv::Mat Integral::standardDeviation(const List<cv::Rect> &rois) const
+{
+  cv::Mat means, deviations;
+  statistics(rois, means, deviations);
+  return deviations;
+}
+
+void Integral::statistics(const List<cv::Rect> &rois, cv::Mat &means, cv::Mat &deviations) const
+{
+  if (integral.type() == CV_32S)
+    clarus::statistics<uint32_t>(integral, integral2, rois, means, deviations);
+  else
+    clarus::statistics<double>(integral, integral2, rois, means, deviations);
+}
+
 } // namespace clarus
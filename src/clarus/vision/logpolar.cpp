@@ -19,12 +19,25 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/vision/logpolar.hpp>
 
-#include <clarus/vision/cvmat.hpp>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+logpolar::Mapper::Mapper():
+    interpolation(cv::INTER_NEAREST),
+    origin(-1, -1)
+{
+    // Nothing to do.
+}
 
-cv::Mat logpolar::transform(const cv::Mat &image, int i_0, int j_0, int p_n, int t_n, bool slide) {
+logpolar::Mapper::Mapper(const cv::Size &size, int i_0, int j_0, int p_n, int t_n, int _interpolation):
+    input(size),
+    interpolation(_interpolation),
+    origin(-1, -1)
+{
     // Original image dimensions.
-    int i_n = image.rows;
-    int j_n = image.cols;
+    int i_n = size.height;
+    int j_n = size.width;
 
     if (i_0 == -1) {
         // The default vertical center is on the middle of the image.
@@ -58,28 +71,102 @@ cv::Mat logpolar::transform(const cv::Mat &image, int i_0, int j_0, int p_n, int
     double p_s = log(d_c) / p_n;
     double t_s = 2.0 * M_PI / t_n;
 
-    // The transform's pixels have the same type and depth as the input's.
-    cv::Mat lp(cv::Size(t_n, p_n * 2), image.type(), cv::Scalar::all(0));
+    // Angular terms only depend on the column, so they are computed once per column.
+    std::vector<double> cosines(t_n);
+    std::vector<double> sines(t_n);
+    for (int t = 0; t < t_n; t++) {
+        double t_rad = t * t_s;
+        cosines[t] = cos(t_rad);
+        sines[t] = sin(t_rad);
+    }
 
-    int p_l = 0;
+    // Rows are stored from the outermost ring inwards, so that the
+    // transform's "bottom" is the region around the center.
+    offsets.create(p_n, t_n, CV_32FC2);
     for (int p = 0; p < p_n; p++) {
         double p_exp = exp(p * p_s);
-        for (int t = 0; t < t_n; t++) {
-            double t_rad = t * t_s;
-
-            int i = i_0 + p_exp * sin(t_rad);
-            int j = j_0 + p_exp * cos(t_rad);
-
-            if (
-                0 <= i && i < i_n &&
-                0 <= j && j < j_n &&
-                !(slide && cvmat::zero(image, i, j))
-            ) {
-                p_l = p_n - p - 1;
-                cvmat::copy(lp, p_l, t, image, i, j);
-            }
+        cv::Vec2f *cell = offsets.ptr<cv::Vec2f>(p_n - p - 1);
+        for (int t = 0; t < t_n; t++, cell++) {
+            (*cell)[0] = p_exp * cosines[t];
+            (*cell)[1] = p_exp * sines[t];
         }
     }
 
-    return lp(cv::Rect(0, p_l, t_n, p_n));
+    recenter(i_0, j_0);
+}
+
+logpolar::Mapper::~Mapper() {
+    // Nothing to do.
+}
+
+cv::Mat logpolar::Mapper::operator () (const cv::Mat &image, bool slide) const {
+    cv::Mat lp;
+    (*this)(image, lp, slide);
+    return lp;
+}
+
+/*
+Returns whether the given row contains any non-blank pixel.
+*/
+inline bool blank(const cv::Mat &row) {
+    return cv::countNonZero(row.reshape(1)) == 0;
+}
+
+void logpolar::Mapper::operator () (const cv::Mat &image, cv::Mat &lp, bool slide) const {
+    if (image.size() != input) {
+        throw std::runtime_error("Image size differs from the size of the log-polar mapper");
+    }
+
+    cv::remap(image, lp, map1, map2, interpolation, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+    if (!slide) {
+        return;
+    }
+
+    int p_n = lp.rows;
+    int p_l = 0;
+    while (p_l < p_n && blank(lp.row(p_l))) {
+        p_l++;
+    }
+
+    if (p_l == 0 || p_l == p_n) {
+        return;
+    }
+
+    // Rows are moved upwards one at a time, so the source of each copy is
+    // always below any row overwritten so far.
+    for (int p = p_l; p < p_n; p++) {
+        lp.row(p).copyTo(lp.row(p - p_l));
+    }
+
+    lp.rowRange(p_n - p_l, p_n).setTo(cv::Scalar::all(0));
+}
+
+void logpolar::Mapper::recenter(int i_0, int j_0) {
+    cv::Point moved(j_0, i_0);
+    if (moved == origin) {
+        return;
+    }
+
+    cv::Mat coordinates;
+    cv::add(offsets, cv::Scalar(j_0, i_0), coordinates);
+    cv::convertMaps(coordinates, cv::noArray(), map1, map2, CV_16SC2, interpolation == cv::INTER_NEAREST);
+
+    origin = moved;
+}
+
+bool logpolar::Mapper::empty() const {
+    return offsets.empty();
+}
+
+cv::Point logpolar::Mapper::center() const {
+    return origin;
+}
+
+cv::Size logpolar::Mapper::size() const {
+    return input;
+}
+
+cv::Mat logpolar::transform(const cv::Mat &image, int i_0, int j_0, int p_n, int t_n, bool slide) {
+    Mapper mapper(image.size(), i_0, j_0, p_n, t_n);
+    return mapper(image, slide);
 }
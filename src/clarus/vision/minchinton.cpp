@@ -19,14 +19,19 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 
 #include <clarus/vision/minchinton.hpp>
 
-cv::Mat minchinton::bgr(const cv::Mat &data) {
-    cv::Mat image(data.size(), CV_8UC3);
-    for (int i = 0; i < data.rows; i++) {
-        for (int j = 0; j < data.cols; j++) {
-            uchar value = (data.at<bool>(i, j) ? 255 : 0);
-            image.at<cv::Vec3b>(i, j) = cv::Vec3b(0, value, 255 - value);
+static void bgr_band(const cv::Mat &data, cv::Mat &image, const clarus::parallel::Band &band) {
+    for (int i = band.rows.start, n = data.cols; i < band.rows.end; i++) {
+        const uchar *cell = data.ptr<uchar>(i);
+        cv::Vec3b *pixel = image.ptr<cv::Vec3b>(i);
+        for (int j = 0; j < n; j++, cell++, pixel++) {
+            uchar value = (*cell != 0 ? 255 : 0);
+            *pixel = cv::Vec3b(0, value, 255 - value);
         }
     }
+}
 
+cv::Mat minchinton::bgr(const cv::Mat &data) {
+    cv::Mat image(data.size(), CV_8UC3);
+    clarus::parallel::bands(data.rows, 0, boost::bind(bgr_band, boost::cref(data), boost::ref(image), _1));
     return image;
 }
@@ -0,0 +1,578 @@
+/*
+Copyright (c) Helio Perroni Filho <xperroni@gmail.com>
+
+This file is part of Clarus.
+
+Clarus is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Clarus is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Clarus. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <clarus/vision/pipeline.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+using clarus::parallel::Band;
+
+/*
+Maximum number of values processed at once by fused passes. Rows are processed in
+segments of at most this length, so values stay in the first-level cache while all
+operations of a pass are applied to them.
+*/
+static const int SEGMENT = 2048;
+
+/*
+Throws an exception if the given matrix is not single-channel.
+*/
+static void check(const cv::Mat &data) {
+    if (data.channels() != 1) {
+        throw std::runtime_error(
+            (boost::format("Pipeline values must be single-channel, got %1% channels") % data.channels()).str()
+        );
+    }
+}
+
+/*
+Returns the given matrix if it's of type CV_64F, otherwise converts it into the given
+scratch matrix and returns that.
+*/
+static const cv::Mat &doubles(const cv::Mat &data, cv::Mat &scratch) {
+    check(data);
+    if (data.depth() == CV_64F) {
+        return data;
+    }
+
+    data.convertTo(scratch, CV_64F);
+    return scratch;
+}
+
+/*
+Returns a pointer to a segment of the given matrix row, converting it into the given
+buffer if the matrix is not of type CV_64F.
+*/
+static const double *segment(const cv::Mat &data, int i, int j, int n, double *buffer) {
+    if (data.depth() == CV_64F) {
+        return data.ptr<double>(i) + j;
+    }
+
+    cv::Mat converted(1, n, CV_64F, buffer);
+    data.row(i).colRange(j, j + n).convertTo(converted, CV_64F);
+    return buffer;
+}
+
+/*
+Gaussian blur with the same kernel size rule and border type as gaussian::blur().
+*/
+static void blur(const cv::Mat &data, cv::Mat &blurred, double w) {
+    int size = 3 * w;
+    if (size % 2 == 0) {
+        size += 1;
+    }
+
+    cv::GaussianBlur(data, blurred, cv::Size(size, size), w, w, cv::BORDER_CONSTANT);
+}
+
+static void equalize_band(
+    const cv::Mat &source,
+    double a,
+    double t,
+    std::vector<double> &sums,
+    const Band &band
+) {
+    double buffer[SEGMENT];
+    for (int i = band.rows.start, n = source.cols; i < band.rows.end; i++) {
+        double s1 = 0.0;
+        double s2 = 0.0;
+        for (int j = 0; j < n; j += SEGMENT) {
+            int k = std::min(SEGMENT, n - j);
+            const double *values = segment(source, i, j, k, buffer);
+            for (int l = 0; l < k; l++) {
+                double v = fabs(values[l]);
+                s1 += ::pow(v, a);
+                s2 += ::pow(std::min(v, t), a);
+            }
+        }
+
+        sums[2 * i] = s1;
+        sums[2 * i + 1] = s2;
+    }
+}
+
+pipeline::Graph::Graph() {
+    add(SOURCE, INPUT);
+}
+
+pipeline::Graph::~Graph() {
+    // Nothing to do.
+}
+
+pipeline::Node pipeline::Graph::add(Kind kind, Node source, double p0, double p1, int type) {
+    int n = vertices.size();
+    if (n > 0 && (source < 0 || source >= n)) {
+        throw std::runtime_error(
+            (boost::format("Invalid source node %1%, graph has %2% nodes") % source % n).str()
+        );
+    }
+
+    Vertex vertex;
+    vertex.kind = kind;
+    vertex.source = source;
+    vertex.p0 = p0;
+    vertex.p1 = p1;
+    vertex.type = type;
+    vertex.output = false;
+    vertices.push_back(vertex);
+
+    steps.clear();
+
+    return n;
+}
+
+pipeline::Node pipeline::Graph::gamma(Node source, double g) {
+    return add(GAMMA, source, g);
+}
+
+pipeline::Node pipeline::Graph::scale(Node source, double a, double b) {
+    return add(SCALE, source, a, b);
+}
+
+pipeline::Node pipeline::Graph::threshold(Node source, double t, double value, int type) {
+    switch (type) {
+        case cv::THRESH_BINARY:
+        case cv::THRESH_BINARY_INV:
+        case cv::THRESH_TRUNC:
+        case cv::THRESH_TOZERO:
+        case cv::THRESH_TOZERO_INV:
+            return add(THRESHOLD, source, t, value, type);
+    }
+
+    throw std::runtime_error((boost::format("Unsupported threshold type %1%") % type).str());
+}
+
+pipeline::Node pipeline::Graph::compress(Node source, double t) {
+    return add(COMPRESS, source, t);
+}
+
+pipeline::Node pipeline::Graph::normalize(Node source, double lower, double upper) {
+    return add(NORMALIZE, source, lower, upper, CV_64F);
+}
+
+pipeline::Node pipeline::Graph::discrete(Node source, bool normalize) {
+    if (normalize) {
+        return add(NORMALIZE, source, 0, 255, CV_8U);
+    }
+
+    return add(DISCRETE, source);
+}
+
+pipeline::Node pipeline::Graph::equalize(Node source, double a, double t) {
+    return add(EQUALIZE, source, a, t);
+}
+
+pipeline::Node pipeline::Graph::blur(Node source, double w) {
+    return add(BLUR, source, w);
+}
+
+pipeline::Node pipeline::Graph::difference(Node source, double w0, double w1) {
+    return add(DIFFERENCE, source, w0, w1);
+}
+
+pipeline::Node pipeline::Graph::filter(Node source, filter::Filter f) {
+    Node node = add(CUSTOM, source);
+    vertices[node].f = f;
+    return node;
+}
+
+pipeline::Node pipeline::Graph::tantriggs(Node source, double a, double t, double g, double w0, double w1) {
+    Node node = gamma(source, g);
+    node = difference(node, w0, w1);
+    node = equalize(node, a, t);
+    return discrete(node);
+}
+
+void pipeline::Graph::output(Node node) {
+    if (node < 0 || node >= (int) vertices.size()) {
+        throw std::runtime_error((boost::format("Invalid node %1%") % node).str());
+    }
+
+    vertices[node].output = true;
+    steps.clear();
+}
+
+void pipeline::Graph::compile() {
+    int n = vertices.size();
+
+    std::vector<int> consumers(n, 0);
+    std::vector<bool> outputs(n, false);
+    for (int v = 1; v < n; v++) {
+        consumers[vertices[v].source]++;
+        outputs[v] = vertices[v].output;
+    }
+
+    outputs[n - 1] = true;
+
+    // Build steps, fusing runs of pointwise nodes into the step computing their source.
+    steps.clear();
+    std::vector<int> producers(n, -1);
+    for (Node v = 1; v < n; v++) {
+        const Vertex &vertex = vertices[v];
+        Kind kind = vertex.kind;
+        Node source = vertex.source;
+
+        Op op;
+        op.code = AFFINE;
+        op.p0 = vertex.p0;
+        op.p1 = vertex.p1;
+        op.type = vertex.type;
+
+        bool fusable = true;
+        switch (kind) {
+            case GAMMA:
+                if (vertex.p0 > 0) {
+                    // Non-integer powers are computed over absolute values, as in cv::pow().
+                    op.code = POW;
+                    op.type = (vertex.p0 == floor(vertex.p0) ? 1 : 0);
+                }
+                else {
+                    op.code = LOG;
+                }
+                break;
+
+            case SCALE:
+                op.code = AFFINE;
+                break;
+
+            case THRESHOLD:
+                op.code = CLAMP;
+                break;
+
+            case COMPRESS:
+                op.code = TANH;
+                break;
+
+            case DISCRETE:
+                break;
+
+            default:
+                fusable = false;
+        }
+
+        int k = producers[source];
+        if (fusable && k >= 0 && consumers[source] == 1 && !outputs[source]) {
+            Step &step = steps[k];
+            Kind head = step.kind;
+            bool pass = (head != BLUR && head != DIFFERENCE && head != CUSTOM);
+            if (pass && step.depth == CV_64F) {
+                if (kind != DISCRETE) {
+                    step.ops.push_back(op);
+                }
+
+                step.node = v;
+                step.depth = (kind == DISCRETE ? CV_8U : CV_64F);
+                producers[source] = -1;
+                producers[v] = k;
+                continue;
+            }
+        }
+
+        Step step;
+        step.kind = kind;
+        step.source = source;
+        step.node = v;
+        step.p0 = vertex.p0;
+        step.p1 = vertex.p1;
+        step.f = vertex.f;
+        step.depth = CV_64F;
+        step.slot = -1;
+
+        if (fusable && kind != DISCRETE) {
+            step.ops.push_back(op);
+        }
+        else if (kind == DISCRETE) {
+            step.depth = CV_8U;
+        }
+        else if (kind == NORMALIZE || kind == EQUALIZE) {
+            // Placeholder for the linear transform computed by the reduction pass.
+            op.code = AFFINE;
+            op.p0 = 1.0;
+            op.p1 = 0.0;
+            step.ops.push_back(op);
+
+            if (kind == NORMALIZE) {
+                step.depth = vertex.type;
+            }
+            else {
+                op.code = TANH;
+                op.p0 = vertex.p1;
+                step.ops.push_back(op);
+            }
+        }
+        else if (kind == CUSTOM) {
+            step.depth = -1;
+        }
+
+        steps.push_back(step);
+        producers[v] = steps.size() - 1;
+    }
+
+    // Assign buffers to step outputs, returning each buffer to the pool after its last
+    // reader. Pooled buffers are only reused for values of the same depth, so they keep
+    // their allocation across runs.
+    int m = steps.size();
+    std::vector<int> last(n, -1);
+    for (int k = 0; k < m; k++) {
+        last[steps[k].source] = k;
+    }
+
+    slots.assign(n, -1);
+    std::vector<int> depths;
+    std::map<int, std::vector<int> > pool;
+    for (int k = 0; k < m; k++) {
+        Step &step = steps[k];
+        Node source = step.source;
+        int slot = (source != INPUT ? slots[source] : -1);
+        bool release = (slot >= 0 && last[source] == k && !outputs[source] && depths[slot] >= 0);
+        bool pass = (step.kind != BLUR && step.kind != DIFFERENCE && step.kind != CUSTOM);
+
+        if (release && pass && depths[slot] == step.depth) {
+            // Pointwise passes can write over their input.
+            step.slot = slot;
+            release = false;
+        }
+        else if (step.depth >= 0 && !pool[step.depth].empty()) {
+            step.slot = pool[step.depth].back();
+            pool[step.depth].pop_back();
+        }
+        else {
+            step.slot = depths.size();
+            depths.push_back(step.depth);
+        }
+
+        if (release) {
+            pool[depths[slot]].push_back(slot);
+        }
+
+        slots[step.node] = step.slot;
+    }
+
+    buffers.resize(depths.size());
+}
+
+const cv::Mat &pipeline::Graph::value(Node node) const {
+    return (node == INPUT ? image : buffers[slots[node]]);
+}
+
+void pipeline::Graph::apply(const std::vector<Op> &ops, double *values, int n) {
+    for (std::vector<Op>::const_iterator i = ops.begin(), o = ops.end(); i != o; ++i) {
+        const Op &op = *i;
+        double *v = values;
+        double *v_n = values + n;
+        switch (op.code) {
+            case POW:
+                if (op.type == 1) {
+                    for (; v < v_n; v++) {
+                        *v = ::pow(*v, op.p0);
+                    }
+                }
+                else {
+                    for (; v < v_n; v++) {
+                        *v = ::pow(fabs(*v), op.p0);
+                    }
+                }
+                break;
+
+            case LOG:
+                for (; v < v_n; v++) {
+                    *v = ::log(*v + 1.0);
+                }
+                break;
+
+            case AFFINE:
+                for (; v < v_n; v++) {
+                    *v = op.p0 * *v + op.p1;
+                }
+                break;
+
+            case CLAMP:
+                for (; v < v_n; v++) {
+                    bool above = (*v > op.p0);
+                    switch (op.type) {
+                        case cv::THRESH_BINARY:     *v = (above ? op.p1 : 0.0); break;
+                        case cv::THRESH_BINARY_INV: *v = (above ? 0.0 : op.p1); break;
+                        case cv::THRESH_TRUNC:      *v = (above ? op.p0 : *v);  break;
+                        case cv::THRESH_TOZERO:     *v = (above ? *v : 0.0);    break;
+                        case cv::THRESH_TOZERO_INV: *v = (above ? 0.0 : *v);    break;
+                    }
+                }
+                break;
+
+            case TANH:
+                for (; v < v_n; v++) {
+                    *v = op.p0 * tanh(*v / op.p0);
+                }
+                break;
+        }
+    }
+}
+
+void pipeline::Graph::fuse_band(
+    const cv::Mat &source,
+    cv::Mat &target,
+    const std::vector<Op> &ops,
+    const Band &band
+) {
+    double buffer[SEGMENT];
+    bool doubles = (target.depth() == CV_64F);
+    for (int i = band.rows.start, n = source.cols; i < band.rows.end; i++) {
+        for (int j = 0; j < n; j += SEGMENT) {
+            int k = std::min(SEGMENT, n - j);
+            const double *u = segment(source, i, j, k, buffer);
+            double *v = (doubles ? target.ptr<double>(i) + j : buffer);
+            if (u != v) {
+                std::copy(u, u + k, v);
+            }
+
+            apply(ops, v, k);
+
+            if (!doubles) {
+                uchar *w = target.ptr<uchar>(i) + j;
+                for (int l = 0; l < k; l++) {
+                    w[l] = cv::saturate_cast<uchar>(v[l]);
+                }
+            }
+        }
+    }
+}
+
+void pipeline::Graph::reduce(Step &step) {
+    const cv::Mat &source = value(step.source);
+    Op &op = step.ops[0];
+    if (step.kind == NORMALIZE) {
+        // Same scaling rule as cv::normalize() with the CV_MINMAX norm.
+        double lower = step.p0;
+        double upper = step.p1;
+        double smin = 0.0;
+        double smax = 0.0;
+        cv::minMaxLoc(source, &smin, &smax);
+        op.p0 = (smax - smin > DBL_EPSILON ? (upper - lower) / (smax - smin) : 0.0);
+        op.p1 = lower - smin * op.p0;
+        return;
+    }
+
+    double a = step.p0;
+    double t = step.p1;
+    int rows = source.rows;
+    step.sums.resize(2 * rows);
+    clarus::parallel::bands(rows, 0, boost::bind(equalize_band, boost::cref(source), a, t, boost::ref(step.sums), _1));
+
+    double s1 = 0.0;
+    double s2 = 0.0;
+    for (int i = 0; i < rows; i++) {
+        s1 += step.sums[2 * i];
+        s2 += step.sums[2 * i + 1];
+    }
+
+    double n = source.total();
+    double mean1 = ::pow(s1 / n, 1.0 / a);
+    double mean2 = ::pow(s2 / n, 1.0 / a);
+    op.p0 = 1.0 / (mean1 * mean2);
+    op.p1 = 0.0;
+}
+
+void pipeline::Graph::fuse(Step &step) {
+    const cv::Mat &source = value(step.source);
+    cv::Mat &target = buffers[step.slot];
+    target.create(source.size(), step.depth);
+    clarus::parallel::bands(source.rows, 0, boost::bind(fuse_band, boost::cref(source), boost::ref(target), boost::cref(step.ops), _1));
+}
+
+void pipeline::Graph::execute(Step &step) {
+    const cv::Mat &source = value(step.source);
+    cv::Mat &target = buffers[step.slot];
+    switch (step.kind) {
+        case BLUR:
+            ::blur(doubles(source, step.converted), target, step.p0);
+            break;
+
+        case DIFFERENCE: {
+            const cv::Mat &data = doubles(source, step.converted);
+            ::blur(data, target, step.p0);
+            ::blur(data, step.blurred, step.p1);
+            cv::subtract(target, step.blurred, target);
+            break;
+        }
+
+        case CUSTOM: {
+            cv::Mat output = step.f(source);
+            if (output.datastart != NULL && output.datastart == source.datastart) {
+                // Filters returning (a view of) their input would alias pooled buffers.
+                output = output.clone();
+            }
+
+            target = output;
+            break;
+        }
+
+        case NORMALIZE:
+        case EQUALIZE:
+            check(source);
+            reduce(step);
+            fuse(step);
+            break;
+
+        default:
+            check(source);
+            fuse(step);
+    }
+}
+
+const cv::Mat &pipeline::Graph::operator () (const cv::Mat &input) {
+    check(input);
+    if (steps.empty()) {
+        compile();
+    }
+
+    image = input;
+    for (std::vector<Step>::iterator i = steps.begin(), n = steps.end(); i != n; ++i) {
+        execute(*i);
+    }
+
+    return value(vertices.size() - 1);
+}
+
+const cv::Mat &pipeline::Graph::operator [] (Node node) const {
+    int n = vertices.size();
+    if (node < 0 || node >= n) {
+        throw std::runtime_error((boost::format("Invalid node %1%") % node).str());
+    }
+
+    if (node != INPUT && !vertices[node].output && node != n - 1) {
+        throw std::runtime_error((boost::format("Node %1% is not an output") % node).str());
+    }
+
+    if (node != INPUT && steps.empty()) {
+        throw std::runtime_error("Graph has not been run since it was last changed");
+    }
+
+    return value(node);
+}
+
+int pipeline::Graph::size() const {
+    return vertices.size();
+}
@@ -23,7 +23,15 @@ along with Clarus. If not, see <http://www.gnu.org/licenses/>.
 using clarus::List;
 using clarus::ListIteratorConst;
 
+#include <clarus/core/parallel.hpp>
+using clarus::parallel::Band;
+
+#include <boost/bind.hpp>
+
 #include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <stdexcept>
 
 inline void blob_set(
     List<int> &neighbors,
@@ -95,35 +103,213 @@ cv::Mat segment::blob(const cv::Mat &data, float threshold) {
     return labels;
 }
 
-cv::Mat segment::kmeans(const cv::Mat &image, int cluster_number) {
-    cv::Mat reshaped_image = image.reshape(1, image.cols * image.rows);
+static void kmeans_check(const cv::Mat &image, int k) {
+    if (image.depth() != CV_8U || image.channels() > 4) {
+        throw std::runtime_error("K-means segmentation requires an 8-bit image of 1 to 4 channels");
+    }
+
+    if (image.total() < (size_t) k) {
+        throw std::runtime_error("Image has fewer pixels than k-means clusters");
+    }
+}
+
+static void kmeans_sample(const cv::Mat &image, int n, cv::RNG &rng, cv::Mat &samples) {
+    int cols = image.cols;
+    int total = image.rows * cols;
+    int channels = image.channels();
+
+    samples.create(n, channels, CV_32F);
+    for (int s = 0; s < n; s++) {
+        int index = rng.uniform(0, total);
+        const uchar *pixel = image.ptr<uchar>(index / cols) + (index % cols) * channels;
+        float *sample = samples.ptr<float>(s);
+        for (int m = 0; m < channels; m++) {
+            sample[m] = pixel[m];
+        }
+    }
+}
+
+static int kmeans_nearest(const cv::Mat &means, const float *sample) {
+    int channels = means.cols;
+    int nearest = 0;
+    float closest = FLT_MAX;
+    for (int l = 0; l < means.rows; l++) {
+        const float *center = means.ptr<float>(l);
+        float distance = 0;
+        for (int m = 0; m < channels; m++) {
+            float d = sample[m] - center[m];
+            distance += d * d;
+        }
+
+        if (distance < closest) {
+            closest = distance;
+            nearest = l;
+        }
+    }
+
+    return nearest;
+}
+
+/*
+Assigns each pixel in the band to its nearest center, writing the center indices to
+labels and / or the center colors to painted (either can be NULL). Channel counts are
+template arguments so the distance loops can be unrolled.
+*/
+template<int C>
+static void kmeans_band(
+    const cv::Mat &image,
+    const std::vector<int> &centers,
+    cv::Mat *labels,
+    cv::Mat *painted,
+    const Band &band
+) {
+    int cols = image.cols;
+    int k = centers.size() / C;
+    for (int i = band.rows.start; i < band.rows.end; i++) {
+        const uchar *pixel = image.ptr<uchar>(i);
+        int *label = (labels != NULL ? labels->ptr<int>(i) : NULL);
+        uchar *color = (painted != NULL ? painted->ptr<uchar>(i) : NULL);
+        for (int j = 0; j < cols; j++, pixel += C) {
+            int nearest = 0;
+            int closest = INT_MAX;
+            for (int l = 0; l < k; l++) {
+                const int *center = &centers[l * C];
+                int distance = 0;
+                for (int m = 0; m < C; m++) {
+                    int d = pixel[m] - center[m];
+                    distance += d * d;
+                }
+
+                if (distance < closest) {
+                    closest = distance;
+                    nearest = l;
+                }
+            }
+
+            if (label != NULL) {
+                label[j] = nearest;
+            }
+
+            if (color != NULL) {
+                const int *center = &centers[nearest * C];
+                for (int m = 0; m < C; m++) {
+                    *color++ = center[m];
+                }
+            }
+        }
+    }
+}
+
+static void kmeans_assign(const cv::Mat &image, const cv::Mat &means, cv::Mat *labels, cv::Mat *painted) {
+    std::vector<int> centers(means.rows * means.cols);
+    for (int l = 0, n = 0; l < means.rows; l++) {
+        const float *center = means.ptr<float>(l);
+        for (int m = 0; m < means.cols; m++, n++) {
+            centers[n] = cv::saturate_cast<uchar>(center[m]);
+        }
+    }
+
+    void (*band)(const cv::Mat&, const std::vector<int>&, cv::Mat*, cv::Mat*, const Band&) = NULL;
+    switch (image.channels()) {
+        case 1: band = kmeans_band<1>; break;
+        case 2: band = kmeans_band<2>; break;
+        case 3: band = kmeans_band<3>; break;
+        case 4: band = kmeans_band<4>; break;
+    }
+
+    clarus::parallel::bands(image.rows, 0, boost::bind(band, boost::cref(image), boost::cref(centers), labels, painted, _1));
+}
+
+segment::KMeans::KMeans(int clusters, int _batch, int _iterations):
+    k(clusters),
+    batch(_batch),
+    iterations(_iterations)
+{
+    if (k < 1 || batch < 1 || iterations < 0) {
+        throw std::runtime_error("Invalid k-means segmenter parameters");
+    }
+}
+
+void segment::KMeans::initialize(const cv::Mat &image) {
+    cv::Mat samples;
+    kmeans_sample(image, std::max(batch, k), rng, samples);
+
+    cv::Mat assigned;
+    cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 10, 1.0);
+    cv::kmeans(samples, k, assigned, criteria, 1, cv::KMEANS_PP_CENTERS, means);
+
+    counts.assign(k, 0);
+    for (int s = 0; s < assigned.rows; s++) {
+        counts[assigned.at<int>(s)] += 1;
+    }
+}
+
+cv::Mat segment::KMeans::operator () (const cv::Mat &image) {
+    update(image);
 
-    cv::Mat reshaped_image32f;
-    reshaped_image.convertTo(reshaped_image32f, CV_64FC1, 1.0 / 255.0);
+    cv::Mat painted(image.size(), image.type());
+    kmeans_assign(image, means, NULL, &painted);
+    return painted;
+}
 
-    cv::Mat labels;
-    cv::TermCriteria criteria(cv::TermCriteria::COUNT, 100, 1);
-    cv::Mat centers;
-    cv::kmeans(reshaped_image32f, cluster_number, labels, criteria, 1, cv::KMEANS_RANDOM_CENTERS, centers);
+void segment::KMeans::update(const cv::Mat &image) {
+    kmeans_check(image, k);
+    int channels = image.channels();
+    if (means.empty() || means.cols != channels) {
+        initialize(image);
+    }
 
-    int width = image.cols;
-    int height = image.rows;
+    for (int l = 0; l < k; l++) {
+        counts[l] *= 0.5f;
+    }
 
-    cv::Mat rgb_image(height, width, CV_8UC3);
-    cv::MatIterator_<cv::Vec3b> rgb_first = rgb_image.begin<cv::Vec3b>();
-    cv::MatIterator_<cv::Vec3b> rgb_last = rgb_image.end<cv::Vec3b>();
-    cv::MatConstIterator_<int> label_first = labels.begin<int>();
+    cv::Mat samples;
+    std::vector<int> nearest(batch);
+    for (int t = 0; t < iterations; t++) {
+        kmeans_sample(image, batch, rng, samples);
+        for (int s = 0; s < batch; s++) {
+            nearest[s] = kmeans_nearest(means, samples.ptr<float>(s));
+        }
 
-    cv::Mat centers_u8;
-    centers.convertTo(centers_u8, CV_8UC1, 255.0);
-    cv::Mat centers_u8c3 = centers_u8.reshape(3);
+        for (int s = 0; s < batch; s++) {
+            int l = nearest[s];
+            float rate = 1.0f / (counts[l] += 1);
+            const float *sample = samples.ptr<float>(s);
+            float *center = means.ptr<float>(l);
+            for (int m = 0; m < channels; m++) {
+                center[m] += rate * (sample[m] - center[m]);
+            }
+        }
+    }
+}
 
-    while ( rgb_first != rgb_last ) {
-        const cv::Vec3b& rgb = centers_u8c3.ptr<cv::Vec3b>(*label_first)[0];
-        *rgb_first = rgb;
-        ++rgb_first;
-        ++label_first;
+cv::Mat segment::KMeans::labels(const cv::Mat &image) const {
+    kmeans_check(image, k);
+    if (means.empty() || means.cols != image.channels()) {
+        throw std::runtime_error("K-means centers not initialized for this image type");
     }
 
-    return rgb_image;
+    cv::Mat assigned(image.size(), CV_32S);
+    kmeans_assign(image, means, &assigned, NULL);
+    return assigned;
+}
+
+cv::Mat segment::KMeans::palette() const {
+    cv::Mat palette;
+    if (!means.empty()) {
+        means.convertTo(palette, CV_8U);
+        palette = palette.reshape(means.cols);
+    }
+
+    return palette;
+}
+
+void segment::KMeans::reset() {
+    means.release();
+    counts.clear();
+}
+
+cv::Mat segment::kmeans(const cv::Mat &image, int cluster_number) {
+    segment::KMeans segmenter(cluster_number);
+    return segmenter(image);
 }